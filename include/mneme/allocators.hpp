@@ -1,10 +1,20 @@
 #ifndef MNEME_ALLOCATORS_H
 #define MNEME_ALLOCATORS_H
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <limits>
+#include <map>
+#include <memory_resource>
+#include <mutex>
 #include <new>
+#include <type_traits>
+#include <vector>
+
+#include <sys/mman.h>
 
 namespace mneme {
 
@@ -57,6 +67,273 @@ bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U,
     return false;
 }
 
+struct HugePageAllocatorBase {};
+/**
+ * Allocator that maps memory directly with mmap and backs it with huge pages.
+ * It first tries explicit 2 MiB huge pages (MAP_HUGETLB) and falls back to a huge page aligned
+ * anonymous mapping with transparent huge pages requested via madvise. The page size is requested
+ * explicitly, as the default hugetlb size may differ, e.g. 1 GiB pages or 512 MiB on aarch64.
+ * Allocations are rounded up to a multiple of the huge page size, so it is meant for large arrays.
+ */
+template <class T> struct HugePageAllocator : public HugePageAllocatorBase {
+    using value_type = T;
+    constexpr static int hugePageShift = 21;
+    constexpr static std::size_t hugePageSize = std::size_t(1) << hugePageShift;
+    constexpr static std::size_t alignment = hugePageSize;
+
+    HugePageAllocator() = default;
+    template <class U> constexpr explicit HugePageAllocator(const HugePageAllocator<U>&) noexcept {}
+
+    template <class U> struct rebind { typedef HugePageAllocator<U> other; };
+
+    [[nodiscard]] T* allocate(std::size_t n) {
+        if (n > (std::numeric_limits<std::size_t>::max() - 2 * hugePageSize) / sizeof(T))
+            throw std::bad_alloc();
+        const auto size = mappedSize(n);
+        if (size == 0U) {
+            return nullptr;
+        }
+        constexpr auto protection = PROT_READ | PROT_WRITE;
+        constexpr auto flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+        constexpr auto hugeFlags = MAP_HUGETLB | (hugePageShift << MAP_HUGE_SHIFT);
+        void* hugeTlb = mmap(nullptr, size, protection, flags | hugeFlags, -1, 0);
+        if (hugeTlb != MAP_FAILED) {
+            return reinterpret_cast<T*>(hugeTlb);
+        }
+#endif
+        // Over-allocate by one huge page and trim the mapping to a huge page aligned range,
+        // such that the kernel can back it with transparent huge pages.
+        void* raw = mmap(nullptr, size + hugePageSize, protection, flags, -1, 0);
+        if (raw == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        const auto rawAddr = reinterpret_cast<std::uintptr_t>(raw);
+        const auto addr = (rawAddr + hugePageSize - 1) / hugePageSize * hugePageSize;
+        if (addr > rawAddr) {
+            munmap(raw, addr - rawAddr);
+        }
+        if (const auto tail = rawAddr + hugePageSize - addr; tail > 0) {
+            munmap(reinterpret_cast<void*>(addr + size), tail);
+        }
+        auto* ptr = reinterpret_cast<void*>(addr);
+#ifdef MADV_HUGEPAGE
+        // Transparent huge pages are only a hint, hence failure is not an error.
+        madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+        return reinterpret_cast<T*>(ptr);
+    }
+    void deallocate(T* ptr, std::size_t n) noexcept {
+        if (ptr != nullptr) {
+            munmap(ptr, mappedSize(n));
+        }
+    }
+
+private:
+    static constexpr std::size_t mappedSize(std::size_t n) {
+        const std::size_t size = n * sizeof(T);
+        return (size > 0U) ? (1U + (size - 1U) / hugePageSize) * hugePageSize : 0U;
+    }
+};
+
+template <class T, class U>
+bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&) {
+    return true;
+}
+template <class T, class U>
+bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&) {
+    return false;
+}
+
+struct PolymorphicAllocatorBase {};
+/**
+ * Stateful allocator that forwards to a std::pmr::memory_resource, which is shared between
+ * all copies of the allocator. Storages propagate their memory resource to the allocators of
+ * their Ids, see MultiStorage(size, resource).
+ * A null resource stands for std::pmr::get_default_resource().
+ */
+template <class T, std::size_t Alignment = alignof(std::max_align_t)>
+struct PolymorphicAllocator : public PolymorphicAllocatorBase {
+    using value_type = T;
+    constexpr static std::size_t alignment = Alignment;
+
+    PolymorphicAllocator() noexcept : PolymorphicAllocator(nullptr) {}
+    explicit PolymorphicAllocator(std::pmr::memory_resource* resource) noexcept
+        : resource_(resource != nullptr ? resource : std::pmr::get_default_resource()) {}
+    template <class U, std::size_t OtherAlignment>
+    explicit PolymorphicAllocator(const PolymorphicAllocator<U, OtherAlignment>& other) noexcept
+        : resource_(other.resource()) {}
+
+    template <class U> struct rebind { typedef PolymorphicAllocator<U, Alignment> other; };
+
+    [[nodiscard]] T* allocate(std::size_t n) {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+            throw std::bad_alloc();
+        return static_cast<T*>(resource_->allocate(n * sizeof(T), blockAlignment));
+    }
+    void deallocate(T* ptr, std::size_t n) noexcept {
+        if (ptr != nullptr) {
+            resource_->deallocate(ptr, n * sizeof(T), blockAlignment);
+        }
+    }
+
+    std::pmr::memory_resource* resource() const noexcept { return resource_; }
+
+private:
+    constexpr static std::size_t blockAlignment = std::max(Alignment, alignof(T));
+
+    std::pmr::memory_resource* resource_;
+};
+
+template <class T, std::size_t Alignment, class U, std::size_t OtherAlignment>
+bool operator==(const PolymorphicAllocator<T, Alignment>& lhs,
+                const PolymorphicAllocator<U, OtherAlignment>& rhs) {
+    return lhs.resource()->is_equal(*rhs.resource());
+}
+template <class T, std::size_t Alignment, class U, std::size_t OtherAlignment>
+bool operator!=(const PolymorphicAllocator<T, Alignment>& lhs,
+                const PolymorphicAllocator<U, OtherAlignment>& rhs) {
+    return !(lhs == rhs);
+}
+
+/**
+ * Thread-safe memory resource that keeps freed blocks in size classes and hands them out again
+ * for requests of the same class, i.e. repeatedly creating storages of similar sizes neither calls
+ * the upstream resource nor faults in fresh pages.
+ * Unlike std::pmr::synchronized_pool_resource, which forwards large blocks directly upstream,
+ * it is meant for large arrays: There are four classes per power of two starting at
+ * minBlockSize, hence at most 25% of a block are unused. Every block is aligned to
+ * blockAlignment. At most maxCachedBytes are kept; freed blocks beyond that limit and all blocks
+ * with larger alignment requirements go straight to the upstream resource.
+ */
+class PooledMemoryResource : public std::pmr::memory_resource {
+public:
+    constexpr static std::size_t minBlockSize = 4096;
+    constexpr static std::size_t blockAlignment = 4096;
+
+    explicit PooledMemoryResource(
+        std::size_t maxCachedBytes = std::numeric_limits<std::size_t>::max(),
+        std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : maxCachedBytes(maxCachedBytes), upstream(upstream) {}
+
+    PooledMemoryResource(PooledMemoryResource const&) = delete;
+    PooledMemoryResource& operator=(PooledMemoryResource const&) = delete;
+
+    ~PooledMemoryResource() override { release(); }
+
+    /**
+     * Returns all cached blocks to the upstream resource.
+     */
+    void release() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& [blockSize, blocks] : freeBlocks) {
+            for (auto* block : blocks) {
+                upstream->deallocate(block, blockSize, blockAlignment);
+            }
+        }
+        freeBlocks.clear();
+        cachedBytes_ = 0;
+    }
+
+    std::size_t cachedBytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return cachedBytes_;
+    }
+
+    static constexpr std::size_t blockSizeOf(std::size_t bytes) {
+        if (bytes <= minBlockSize) {
+            return minBlockSize;
+        }
+        std::size_t power = minBlockSize;
+        while (2 * power < bytes) {
+            power *= 2;
+        }
+        // power < bytes <= 2 * power
+        const auto step = power / subClasses;
+        return (bytes + step - 1) / step * step;
+    }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        if (alignment > blockAlignment) {
+            return upstream->allocate(bytes, alignment);
+        }
+        const auto blockSize = blockSizeOf(bytes);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = freeBlocks.find(blockSize);
+            if (it != freeBlocks.end() && !it->second.empty()) {
+                auto* block = it->second.back();
+                it->second.pop_back();
+                cachedBytes_ -= blockSize;
+                return block;
+            }
+        }
+        return upstream->allocate(blockSize, blockAlignment);
+    }
+
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override {
+        if (alignment > blockAlignment) {
+            upstream->deallocate(ptr, bytes, alignment);
+            return;
+        }
+        const auto blockSize = blockSizeOf(bytes);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (cachedBytes_ + blockSize <= maxCachedBytes) {
+                freeBlocks[blockSize].push_back(ptr);
+                cachedBytes_ += blockSize;
+                return;
+            }
+        }
+        upstream->deallocate(ptr, blockSize, blockAlignment);
+    }
+
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+        return this == &other;
+    }
+
+    constexpr static std::size_t subClasses = 4;
+
+    std::size_t maxCachedBytes;
+    std::pmr::memory_resource* upstream;
+    mutable std::mutex mutex;
+    std::map<std::size_t, std::vector<void*>> freeBlocks;
+    std::size_t cachedBytes_ = 0;
+};
+
+/**
+ * Returns the number of bytes an allocator actually reserves for a request of the given size,
+ * i.e. including the round-up of aligned and huge page allocations and, for a
+ * PolymorphicAllocator drawing from a PooledMemoryResource, the round-up to the size class.
+ * The resource is only used by polymorphic allocators; nullptr stands for the default resource.
+ */
+template <typename Allocator>
+constexpr std::size_t allocatedBytes(std::size_t bytes,
+                                     std::pmr::memory_resource* resource = nullptr) {
+    auto roundUp = [bytes](std::size_t multiple) {
+        return (bytes > 0U) ? (1U + (bytes - 1U) / multiple) * multiple : 0U;
+    };
+    if constexpr (std::is_base_of_v<AlignedAllocatorBase, Allocator>) {
+        return roundUp(Allocator::alignment);
+    } else if constexpr (std::is_base_of_v<HugePageAllocatorBase, Allocator>) {
+        return roundUp(Allocator::hugePageSize);
+    } else if constexpr (std::is_base_of_v<PolymorphicAllocatorBase, Allocator>) {
+        if (resource == nullptr) {
+            resource = std::pmr::get_default_resource();
+        }
+        constexpr auto alignment =
+            std::max(Allocator::alignment, alignof(typename Allocator::value_type));
+        const bool pooled = dynamic_cast<PooledMemoryResource*>(resource) != nullptr;
+        if (bytes > 0U && pooled && alignment <= PooledMemoryResource::blockAlignment) {
+            return PooledMemoryResource::blockSizeOf(bytes);
+        }
+        return bytes;
+    } else {
+        return bytes;
+    }
+}
+
 namespace detail {
 template <typename, typename = void> inline constexpr bool hasAllocatorDefined = false;
 
@@ -75,6 +352,17 @@ struct AllocatorGetter {
         }
     }
     using type = decltype(makeAllocator());
+
+    /**
+     * Like makeAllocator() but hands the memory resource to polymorphic allocators.
+     */
+    static auto makeAllocator(std::pmr::memory_resource* resource) {
+        if constexpr (std::is_base_of_v<PolymorphicAllocatorBase, type>) {
+            return type(resource);
+        } else {
+            return makeAllocator();
+        }
+    }
 };
 
 template <typename... List> struct AllocatorInfo;
@@ -90,11 +378,17 @@ template <typename Head, typename... Tail> struct AllocatorInfo<Head, Tail...> {
     static constexpr bool allSameAllocator() {
         using own_t = typename AllocatorGetter<Head>::type;
         static_assert(std::is_base_of_v<AlignedAllocatorBase, own_t> ||
+                          std::is_base_of_v<HugePageAllocatorBase, own_t> ||
+                          std::is_base_of_v<PolymorphicAllocatorBase, own_t> ||
                           std::is_base_of_v<StandardAllocatorBase, own_t>,
-                      "AllocatorInfo::allSameAllocator is only defined for Aligned and Standard "
-                      "allocator currently");
+                      "AllocatorInfo::allSameAllocator is only defined for Aligned, HugePage, "
+                      "Polymorphic and Standard allocator currently");
         if constexpr (std::is_base_of_v<AlignedAllocatorBase, own_t>) {
             return allSameAllocatorAs<AlignedAllocatorBase>();
+        } else if constexpr (std::is_base_of_v<HugePageAllocatorBase, own_t>) {
+            return allSameAllocatorAs<HugePageAllocatorBase>();
+        } else if constexpr (std::is_base_of_v<PolymorphicAllocatorBase, own_t>) {
+            return allSameAllocatorAs<PolymorphicAllocatorBase>();
         } else if constexpr (std::is_base_of_v<StandardAllocatorBase, own_t>) {
             return allSameAllocatorAs<StandardAllocatorBase>();
         } else {
@@ -104,8 +398,11 @@ template <typename Head, typename... Tail> struct AllocatorInfo<Head, Tail...> {
 
     static constexpr std::size_t getMaxAlignment() {
         using own_t = typename AllocatorGetter<Head>::type;
-        static_assert(std::is_base_of_v<AlignedAllocatorBase, own_t>,
-                      "Maximum alignment is only defined if all allocators are AlignedAllocator");
+        static_assert(std::is_base_of_v<AlignedAllocatorBase, own_t> ||
+                          std::is_base_of_v<HugePageAllocatorBase, own_t> ||
+                          std::is_base_of_v<PolymorphicAllocatorBase, own_t>,
+                      "Maximum alignment is only defined if all allocators are AlignedAllocator, "
+                      "HugePageAllocator or PolymorphicAllocator");
         return std::max(AllocatorInfo<Tail...>::getMaxAlignment(), own_t::alignment);
     }
 };
@@ -0,0 +1,143 @@
+#ifndef MNEME_CONVERT_H_
+#define MNEME_CONVERT_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+#include "storage.hpp"
+
+namespace mneme {
+
+namespace detail {
+/**
+ * Returns the distance in bytes between consecutive entries of Id within a run, where AoSoA runs
+ * end at block boundaries, see runLength.
+ */
+template <typename Id, DataLayout TDataLayout, typename... Ids>
+constexpr std::size_t fieldStride() {
+    if constexpr (TDataLayout == DataLayout::AoS) {
+        return sizeof(tagged_tuple<Ids...>);
+    } else {
+        return sizeof(typename Id::type);
+    }
+}
+
+/**
+ * Number of entries starting at pos that are equidistant, i.e. up to the end of pos's block
+ * for AoSoA and up to to otherwise.
+ */
+template <DataLayout TDataLayout, typename Values>
+std::size_t runLength(Values const& values, std::size_t pos, std::size_t to) {
+    if constexpr (isAoSoA(TDataLayout)) {
+        constexpr auto width = blockWidth(TDataLayout);
+        return std::min(to - pos, width - (values.start + pos) % width);
+    } else {
+        return to - pos;
+    }
+}
+
+template <typename T, std::size_t DstStride, std::size_t SrcStride>
+void copyStrided(std::byte* __restrict dst, std::byte const* __restrict src, std::size_t count) {
+    // Strides are compile-time constants, which lets the compiler turn the loop into
+    // vector loads, shuffles and stores.
+    for (std::size_t i = 0; i < count; ++i) {
+        *reinterpret_cast<T*>(dst + i * DstStride) =
+            *reinterpret_cast<T const*>(src + i * SrcStride);
+    }
+}
+
+template <typename Id, DataLayout DstLayout, DataLayout SrcLayout, typename... Ids>
+void convertField(MultiStorage<DstLayout, Ids...>& dst, MultiStorage<SrcLayout, Ids...> const& src,
+                  std::size_t from, std::size_t to) {
+    using T = typename Id::type;
+    using dst_policy_t = typename MultiStorage<DstLayout, Ids...>::allocate_policy_t;
+    using src_policy_t = typename MultiStorage<SrcLayout, Ids...>::allocate_policy_t;
+    constexpr auto dstStride = fieldStride<Id, DstLayout, Ids...>();
+    constexpr auto srcStride = fieldStride<Id, SrcLayout, Ids...>();
+    if (from == to) {
+        return;
+    }
+    if constexpr (std::is_trivially_copyable_v<T>) {
+        // AoSoA blocks are copied as contiguous runs of up to BlockWidth entries.
+        for (std::size_t pos = from; pos < to;) {
+            const auto count = std::min(runLength<DstLayout>(dst.data(), pos, to),
+                                        runLength<SrcLayout>(src.data(), pos, to));
+            auto* dstPtr = dst_policy_t::template address<Id>(dst.data(), pos);
+            const auto* srcPtr = src_policy_t::template address<Id>(src.data(), pos);
+            copyStrided<T, dstStride, srcStride>(reinterpret_cast<std::byte*>(dstPtr),
+                                                 reinterpret_cast<std::byte const*>(srcPtr),
+                                                 count);
+            pos += count;
+        }
+    } else {
+        for (std::size_t i = from; i < to; ++i) {
+            *dst_policy_t::template address<Id>(dst.data(), i) =
+                *src_policy_t::template address<Id>(src.data(), i);
+        }
+    }
+}
+} // namespace detail
+
+/**
+ * Copies the entries [from, to) of src into the already constructed entries of dst, where
+ * src and dst share the same Ids but may use different data layouts (SoA, AoS, AoSoA).
+ *
+ * The range is processed in cache-sized tiles, one Id at a time, such that the tuples or blocks of
+ * a tile stay in cache while all Ids are transposed. Tiles are distributed with a static OpenMP
+ * schedule.
+ */
+template <DataLayout DstLayout, DataLayout SrcLayout, typename... Ids>
+void convertLayout(MultiStorage<DstLayout, Ids...>& dst,
+                   MultiStorage<SrcLayout, Ids...> const& src, std::size_t from, std::size_t to) {
+    if (to < from || to > src.size() || to > dst.size()) {
+        throw std::out_of_range("Conversion range exceeds storage size.");
+    }
+    constexpr std::size_t tileBytes = 16384;
+    constexpr std::size_t tileSize =
+        std::max(std::size_t(64), tileBytes / sizeof(tagged_tuple<Ids...>));
+    const auto numTiles = static_cast<std::ptrdiff_t>((to - from + tileSize - 1) / tileSize);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (std::ptrdiff_t tile = 0; tile < numTiles; ++tile) {
+        const auto tileFrom = from + static_cast<std::size_t>(tile) * tileSize;
+        const auto tileTo = std::min(to, tileFrom + tileSize);
+        (detail::convertField<Ids>(dst, src, tileFrom, tileTo), ...);
+    }
+}
+
+/**
+ * Copies all entries of src into dst, see convertLayout(dst, src, from, to).
+ */
+template <DataLayout DstLayout, DataLayout SrcLayout, typename... Ids>
+void convertLayout(MultiStorage<DstLayout, Ids...>& dst,
+                   MultiStorage<SrcLayout, Ids...> const& src) {
+    if (dst.size() != src.size()) {
+        throw std::invalid_argument("Storages must have the same size.");
+    }
+    convertLayout(dst, src, 0, src.size());
+}
+
+/**
+ * Copies the entries of the selected layers of a LayeredPlan or CombinedLayeredPlan from src to
+ * dst, e.g. convertLayers<Interior, Copy>(dst, src, plan).
+ */
+template <typename... SelectedLayers, typename PlanT, DataLayout DstLayout, DataLayout SrcLayout,
+          typename... Ids>
+void convertLayers(MultiStorage<DstLayout, Ids...>& dst,
+                   MultiStorage<SrcLayout, Ids...> const& src, PlanT const& plan) {
+    const auto& layout = plan.getLayout();
+    plan.forEachLayer([&](auto const& layer) {
+        using layer_t = std::decay_t<decltype(layer)>;
+        if constexpr ((std::is_same_v<layer_t, SelectedLayers> || ...)) {
+            convertLayout(dst, src, layout[layer.offset],
+                          layout[layer.offset + layer.numElements]);
+        }
+    });
+}
+
+} // namespace mneme
+
+#endif // MNEME_CONVERT_H_
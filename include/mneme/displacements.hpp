@@ -1,14 +1,43 @@
 #ifndef MNEME_DISPLACEMENTS_HPP
 #define MNEME_DISPLACEMENTS_HPP
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <iterator>
+#include <limits>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace mneme {
 
+namespace detail {
+// Number of ids from which counts are summed on all OpenMP threads.
+constexpr std::size_t parallelCountThreshold = std::size_t(1) << 16;
+
+/**
+ * Returns the sum of countOf(p) for p in [0, n), reduced on all OpenMP threads for large n.
+ */
+template <typename CountFunc> std::uint64_t sumCounts(std::size_t n, CountFunc const& countOf) {
+    std::uint64_t total = 0;
+#ifdef _OPENMP
+    [[maybe_unused]] const bool parallel =
+        n >= parallelCountThreshold && omp_get_max_threads() > 1 && !omp_in_parallel();
+#pragma omp parallel for schedule(static) reduction(+ : total) if (parallel)
+#endif
+    for (std::ptrdiff_t p = 0; p < static_cast<std::ptrdiff_t>(n); ++p) {
+        total += static_cast<std::uint64_t>(countOf(static_cast<std::size_t>(p)));
+    }
+    return total;
+}
+} // namespace detail
+
 template <typename IntT> class DisplacementsIterator {
 public:
     using iterator_category = std::forward_iterator_tag;
@@ -28,15 +57,18 @@ public:
         }
     }
 
-    bool operator!=(DisplacementsIterator const& other) {
+    bool operator!=(DisplacementsIterator const& other) const {
         return i != other.i || p != other.p || &displs != &other.displs;
     }
-    bool operator==(DisplacementsIterator const& other) { return !(*this != other); }
+    bool operator==(DisplacementsIterator const& other) const { return !(*this != other); }
 
     DisplacementsIterator& operator++() {
         assert(i >= displs[p] && i < displs[p + 1]);
         ++i;
-        next();
+        // Only skip (empty) owners at the end of the current owner's items.
+        if (i >= displs[p + 1]) {
+            next();
+        }
         return *this;
     }
     DisplacementsIterator operator++(int) {
@@ -97,16 +129,122 @@ public:
     template <typename OtherIntT>
     Displacements(std::vector<OtherIntT> const& count) { make(count); }
 
+    /**
+     * Builds the displacements of n ids with countOf(p) items for id p without an intermediate
+     * vector of counts. countOf is called once per id, possibly from multiple threads.
+     */
+    template <typename CountFunc,
+              typename std::enable_if_t<std::is_invocable_v<CountFunc const&, std::size_t>,
+                                        int> = 0>
+    Displacements(std::size_t n, CountFunc const& countOf) {
+        make(n, countOf);
+    }
+
+    /**
+     * Builds the displacements from the counts in [first, last).
+     */
+    template <typename InputIt,
+              typename = typename std::iterator_traits<InputIt>::iterator_category>
+    Displacements(InputIt first, InputIt last) {
+        using category_t = typename std::iterator_traits<InputIt>::iterator_category;
+        if constexpr (std::is_base_of_v<std::random_access_iterator_tag, category_t>) {
+            make(static_cast<std::size_t>(last - first),
+                 [first](std::size_t p) { return first[p]; });
+        } else {
+            displs.assign(1, 0);
+            for (; first != last; ++first) {
+                displs.push_back(displs.back() + static_cast<IntT>(*first));
+            }
+        }
+    }
+
     template <typename OtherIntT>
     void make(std::vector<OtherIntT> const& count) {
-        displs.resize(count.size() + 1);
+        make(count.size(), [&count](std::size_t p) { return count[p]; });
+    }
+
+    /**
+     * Computes the prefix sum of the counts. Large inputs are summed by a two-pass blocked scan
+     * on all OpenMP threads: each thread stores and reduces the counts of its block, the block
+     * offsets are summed up, and each thread turns its block into a prefix sum in place.
+     */
+    template <typename CountFunc> void make(std::size_t n, CountFunc const& countOf) {
+        displs.resize(n + 1);
         displs[0] = 0;
-        for (IntT p = 0; p < static_cast<IntT>(count.size()); ++p) {
-            displs[p + 1] = displs[p] + count[p];
+#ifdef _OPENMP
+        if (n >= parallelThreshold && omp_get_max_threads() > 1 && !omp_in_parallel()) {
+            makeParallel(n, countOf);
+            return;
+        }
+#endif
+        IntT sum = 0;
+        for (std::size_t p = 0; p < n; ++p) {
+            sum += static_cast<IntT>(countOf(p));
+            displs[p + 1] = sum;
         }
     }
 
     std::size_t size() const { return displs.size() - 1; }
+
+    /**
+     * Returns the id p that owns item, i.e. displs[p] <= item < displs[p+1], by a branch-free
+     * binary search. item must be smaller than back().
+     */
+    std::size_t owner(IntT item) const {
+        assert(item < back());
+        const IntT* base = displs.data();
+        std::size_t n = displs.size();
+        while (n > 1) {
+            const auto half = n / 2;
+            base = base[half] <= item ? base + half : base;
+            n -= half;
+        }
+        return static_cast<std::size_t>(base - displs.data());
+    }
+
+    /**
+     * Returns the items [first, last) of chunk chunkNo when all items are split into numChunks
+     * chunks of (almost) equal size.
+     */
+    std::pair<IntT, IntT> chunk(std::size_t chunkNo, std::size_t numChunks) const {
+        const auto numItems = static_cast<std::size_t>(back());
+        return {static_cast<IntT>(numItems * chunkNo / numChunks),
+                static_cast<IntT>(numItems * (chunkNo + 1) / numChunks)};
+    }
+
+    /**
+     * Calls func(p, i) for the items i in [first, last), where p is the owner of i.
+     */
+    template <typename Func> void forEachItem(IntT first, IntT last, Func&& func) const {
+        if (!(first < last)) {
+            return;
+        }
+        auto p = owner(first);
+        for (auto i = first; i < last; ++p) {
+            const auto end = std::min(last, displs[p + 1]);
+            for (; i < end; ++i) {
+                func(p, i);
+            }
+        }
+    }
+
+    /**
+     * Calls func(p, i) for all items, where every OpenMP thread processes a chunk of equal size
+     * irrespective of how the items are distributed over the ids.
+     */
+    template <typename Func> void forEachItemParallel(Func&& func) const {
+#ifdef _OPENMP
+#pragma omp parallel
+        {
+            const auto [first, last] = chunk(static_cast<std::size_t>(omp_get_thread_num()),
+                                             static_cast<std::size_t>(omp_get_num_threads()));
+            forEachItem(first, last, func);
+        }
+#else
+        forEachItem(0, back(), func);
+#endif
+    }
+
     DisplacementsIterator<IntT> begin() const { return DisplacementsIterator(displs, false); }
     DisplacementsIterator<IntT> end() const { return DisplacementsIterator(displs, true); }
 
@@ -121,9 +259,259 @@ public:
     IntT back() const { return displs.back(); }
 
 private:
+    constexpr static std::size_t parallelThreshold = detail::parallelCountThreshold;
+
+#ifdef _OPENMP
+    template <typename CountFunc> void makeParallel(std::size_t n, CountFunc const& countOf) {
+        std::vector<IntT> blockOffsets;
+#pragma omp parallel
+        {
+            const auto numThreads = static_cast<std::size_t>(omp_get_num_threads());
+            const auto threadId = static_cast<std::size_t>(omp_get_thread_num());
+#pragma omp single
+            blockOffsets.assign(numThreads + 1, 0);
+
+            const auto from = n * threadId / numThreads;
+            const auto to = n * (threadId + 1) / numThreads;
+            IntT sum = 0;
+            for (std::size_t p = from; p < to; ++p) {
+                const auto count = static_cast<IntT>(countOf(p));
+                displs[p + 1] = count;
+                sum += count;
+            }
+            blockOffsets[threadId + 1] = sum;
+#pragma omp barrier
+#pragma omp single
+            for (std::size_t t = 0; t < numThreads; ++t) {
+                blockOffsets[t + 1] += blockOffsets[t];
+            }
+
+            IntT offset = blockOffsets[threadId];
+            for (std::size_t p = from; p < to; ++p) {
+                offset += displs[p + 1];
+                displs[p + 1] = offset;
+            }
+        }
+    }
+#endif
+
     std::vector<IntT> displs;
 };
 
+/**
+ * Sampled inverse of Displacements: stores the owner of every itemsPerSample-th item, such that
+ * owner(item) only searches the ids between two samples. With itemsPerSample = 1 the table holds
+ * the owner of every item and a lookup is a single load.
+ *
+ * The index keeps a raw pointer to the offsets of the displacements, hence the displacements
+ * must outlive the index and must not change. Anything that reallocates or moves their buffer,
+ * e.g. make(), swap() or moving the Displacements, invalidates the index.
+ */
+template <typename IntT> class OwnerIndex {
+public:
+    OwnerIndex(Displacements<IntT> const& displacements, std::size_t itemsPerSample = 64)
+        : displs(displacements.data()), shift(0) {
+        while ((std::size_t(1) << shift) < itemsPerSample) {
+            ++shift;
+        }
+        const auto numItems = static_cast<std::size_t>(displacements.back());
+        const auto numSamples = (numItems >> shift) + 1;
+        samples.resize(numSamples + 1);
+        for (std::size_t j = 0; j < numSamples; ++j) {
+            const auto item = std::min(j << shift, numItems);
+            samples[j] = item < numItems ? displacements.owner(static_cast<IntT>(item))
+                                         : displacements.size() - 1;
+        }
+        samples[numSamples] = displacements.size() - 1;
+    }
+
+    std::size_t owner(IntT item) const {
+        const auto j = static_cast<std::size_t>(item) >> shift;
+        std::size_t p = samples[j];
+        std::size_t n = samples[j + 1] - p + 1;
+        const IntT* base = displs + p;
+        while (n > 1) {
+            const auto half = n / 2;
+            base = base[half] <= item ? base + half : base;
+            n -= half;
+        }
+        return static_cast<std::size_t>(base - displs);
+    }
+
+    std::size_t itemsPerSample() const noexcept { return std::size_t(1) << shift; }
+
+private:
+    IntT const* displs;
+    unsigned shift;
+    std::vector<std::size_t> samples;
+};
+
+/**
+ * Displacements that store 32-bit offsets if the total number of items fits and 64-bit offsets
+ * otherwise, i.e. they halve the size of most layouts.
+ *
+ * operator[] and count() convert to std::size_t, such that CompactDisplacements can be passed
+ * wherever a layout is accepted. In tight loops, use visit(func), which calls func with the
+ * underlying Displacements<std::uint32_t> or Displacements<std::uint64_t>.
+ */
+class CompactDisplacements {
+public:
+    CompactDisplacements() = default;
+
+    template <typename CountFunc,
+              typename std::enable_if_t<std::is_invocable_v<CountFunc const&, std::size_t>,
+                                        int> = 0>
+    CompactDisplacements(std::size_t n, CountFunc const& countOf)
+        : CompactDisplacements(n, countOf, detail::sumCounts(n, countOf)) {}
+
+    /**
+     * Like CompactDisplacements(n, countOf) but takes the known sum of all counts, e.g. the
+     * number of dofs of a plan, such that countOf is called only once per id.
+     */
+    template <typename CountFunc,
+              typename std::enable_if_t<std::is_invocable_v<CountFunc const&, std::size_t>,
+                                        int> = 0>
+    CompactDisplacements(std::size_t n, CountFunc const& countOf, std::uint64_t total) {
+        if (total <= narrowMax) {
+            narrow.make(n, countOf);
+        } else {
+            compact = false;
+            wide.make(n, countOf);
+        }
+    }
+
+    template <typename IntT>
+    explicit CompactDisplacements(Displacements<IntT> const& displacements)
+        : CompactDisplacements(
+              displacements.size(),
+              [&displacements](std::size_t p) { return displacements.count(p); },
+              static_cast<std::uint64_t>(displacements.back())) {}
+
+    /**
+     * Returns whether offsets are stored with 32 bits.
+     */
+    bool isCompact() const noexcept { return compact; }
+
+    std::size_t size() const { return compact ? narrow.size() : wide.size(); }
+    std::size_t operator[](std::size_t p) const { return compact ? narrow[p] : wide[p]; }
+    std::size_t count(std::size_t p) const { return compact ? narrow.count(p) : wide.count(p); }
+    std::size_t back() const { return compact ? narrow.back() : wide.back(); }
+
+    /**
+     * Returns the number of bytes of the stored offsets.
+     */
+    std::size_t bytes() const {
+        return compact ? (narrow.size() + 1) * sizeof(std::uint32_t)
+                       : (wide.size() + 1) * sizeof(std::uint64_t);
+    }
+
+    template <typename Func> decltype(auto) visit(Func&& func) const {
+        return compact ? func(narrow) : func(wide);
+    }
+
+private:
+    constexpr static std::uint64_t narrowMax = std::numeric_limits<std::uint32_t>::max();
+
+    bool compact = true;
+    Displacements<std::uint32_t> narrow;
+    Displacements<std::uint64_t> wide;
+};
+
+/**
+ * Layout that stores runs of ids with the same count as (first id, offset, count) and computes
+ * their offsets analytically, e.g. a layer whose elements all have 10 dofs takes a single run
+ * instead of one offset per element. Ids in runs shorter than minRunLength are stored explicitly.
+ *
+ * Like CompactDisplacements, RunLengthDisplacements can be passed wherever a layout is accepted.
+ * operator[] searches the runs, hence it is cheap for the few runs of a layered plan.
+ */
+class RunLengthDisplacements {
+public:
+    constexpr static std::size_t defaultMinRunLength = 16;
+
+    RunLengthDisplacements() : runs{Run{0, 0, 0, 0, true}} {}
+
+    template <typename CountFunc,
+              typename std::enable_if_t<std::is_invocable_v<CountFunc const&, std::size_t>,
+                                        int> = 0>
+    RunLengthDisplacements(std::size_t n, CountFunc const& countOf,
+                           std::size_t minRunLength = defaultMinRunLength) {
+        std::size_t offset = 0;
+        std::size_t p = 0;
+        while (p < n) {
+            const auto count = static_cast<std::size_t>(countOf(p));
+            auto q = p + 1;
+            while (q < n && static_cast<std::size_t>(countOf(q)) == count) {
+                ++q;
+            }
+            if (q - p >= minRunLength) {
+                runs.push_back(Run{p, offset, count, 0, true});
+                offset += (q - p) * count;
+            } else {
+                if (runs.empty() || runs.back().uniform) {
+                    runs.push_back(Run{p, offset, 0, explicitOffsets.size(), false});
+                }
+                for (; p < q; ++p) {
+                    explicitOffsets.push_back(offset);
+                    offset += count;
+                }
+            }
+            p = q;
+        }
+        runs.push_back(Run{n, offset, 0, 0, true});
+    }
+
+    template <typename IntT>
+    explicit RunLengthDisplacements(Displacements<IntT> const& displacements,
+                                    std::size_t minRunLength = defaultMinRunLength)
+        : RunLengthDisplacements(
+              displacements.size(),
+              [&displacements](std::size_t p) { return displacements.count(p); }, minRunLength) {}
+
+    std::size_t size() const noexcept { return runs.back().first; }
+
+    std::size_t operator[](std::size_t p) const {
+        const auto& run = findRun(p);
+        return run.uniform ? run.offset + (p - run.first) * run.count
+                           : explicitOffsets[run.explicitFirst + (p - run.first)];
+    }
+    std::size_t count(std::size_t p) const { return (*this)[p + 1] - (*this)[p]; }
+    std::size_t back() const noexcept { return runs.back().offset; }
+
+    /**
+     * Returns the number of runs, where consecutive irregular ids form one run.
+     */
+    std::size_t numRuns() const noexcept { return runs.size() - 1; }
+
+    /**
+     * Returns the number of bytes of the stored runs and explicit offsets.
+     */
+    std::size_t bytes() const noexcept {
+        return runs.size() * sizeof(Run) + explicitOffsets.size() * sizeof(std::size_t);
+    }
+
+private:
+    struct Run {
+        std::size_t first;
+        std::size_t offset;
+        std::size_t count;
+        std::size_t explicitFirst;
+        bool uniform;
+    };
+
+    Run const& findRun(std::size_t p) const {
+        const auto next = std::upper_bound(runs.begin(), runs.end(), p,
+                                           [](std::size_t id, Run const& run) {
+                                               return id < run.first;
+                                           });
+        return *(next - 1);
+    }
+
+    // The last run is a sentinel that starts at size() with offset back().
+    std::vector<Run> runs;
+    std::vector<std::size_t> explicitOffsets;
+};
+
 } // namespace mneme
 
 #endif // MNEME_DISPLACEMENTS_HPP
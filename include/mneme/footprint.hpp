@@ -0,0 +1,161 @@
+#ifndef MNEME_FOOTPRINT_H_
+#define MNEME_FOOTPRINT_H_
+
+#include <cstddef>
+#include <memory_resource>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "plan.hpp"
+#include "storage.hpp"
+#include "util.hpp"
+
+namespace mneme {
+
+/**
+ * Memory held by a storage, broken down by Id, layer and cluster.
+ *
+ * Id, layer and cluster bytes only count the entries themselves (payload). The remainder of
+ * totalBytes is split into unused capacity and padding, where padding includes the round-up of
+ * aligned and huge page allocations, padding inside tuples, unused AoSoA lanes and the gaps
+ * between the arrays of an arena. Memory owned by the values themselves, e.g. the heap buffer of
+ * a std::vector, is not included.
+ */
+struct MemoryFootprint {
+    struct IdFootprint {
+        std::string name;
+        std::size_t bytes;
+    };
+    struct LayerFootprint {
+        std::size_t clusterId;
+        std::string name;
+        std::size_t numElements;
+        std::size_t numEntries;
+        std::size_t bytes;
+    };
+
+    std::size_t numEntries = 0;
+    std::size_t capacity = 0;
+    std::vector<IdFootprint> ids;
+    std::vector<LayerFootprint> layers;
+    std::vector<std::size_t> clusterBytes;
+    std::size_t payloadBytes = 0;
+    std::size_t unusedCapacityBytes = 0;
+    std::size_t paddingBytes = 0;
+    std::size_t totalBytes = 0;
+};
+
+namespace detail {
+template <DataLayout TDataLayout, typename... Ids>
+MemoryFootprint makeFootprint(MultiStorage<TDataLayout, Ids...> const*, std::size_t numEntries,
+                              std::size_t capacity, std::pmr::memory_resource* resource) {
+    using allocate_policy_t = typename MultiStorage<TDataLayout, Ids...>::allocate_policy_t;
+    constexpr std::size_t entryBytes = (sizeof(typename Ids::type) + ... + 0);
+    MemoryFootprint result;
+    result.numEntries = numEntries;
+    result.capacity = capacity;
+    result.ids = {MemoryFootprint::IdFootprint{typeName<Ids>(),
+                                               numEntries * sizeof(typename Ids::type)}...};
+    result.payloadBytes = numEntries * entryBytes;
+    result.unusedCapacityBytes = (capacity - numEntries) * entryBytes;
+    result.totalBytes = capacity > 0 ? allocate_policy_t::allocatedBytes(capacity, resource) : 0;
+    result.paddingBytes = result.totalBytes - result.payloadBytes - result.unusedCapacityBytes;
+    return result;
+}
+
+template <typename PlanT>
+void addLayers(MemoryFootprint& result, PlanT const& plan, std::size_t entryBytes) {
+    const auto& layout = plan.getLayout();
+    auto addLayer = [&](std::size_t clusterId, auto const& layer) {
+        using layer_t = std::decay_t<decltype(layer)>;
+        const auto numEntries = layout[layer.offset + layer.numElements] - layout[layer.offset];
+        result.layers.push_back(MemoryFootprint::LayerFootprint{clusterId, typeName<layer_t>(),
+                                                                layer.numElements, numEntries,
+                                                                numEntries * entryBytes});
+        if (result.clusterBytes.size() <= clusterId) {
+            result.clusterBytes.resize(clusterId + 1, 0);
+        }
+        result.clusterBytes[clusterId] += numEntries * entryBytes;
+    };
+    if constexpr (std::is_base_of_v<CombinedLayeredPlanBase, PlanT>) {
+        plan.forEachClusterLayer(addLayer);
+    } else {
+        plan.forEachLayer([&](auto const& layer) { addLayer(0, layer); });
+    }
+}
+
+inline std::size_t entryBytes(MemoryFootprint const& result) {
+    return result.numEntries > 0 ? result.payloadBytes / result.numEntries : 0;
+}
+
+template <typename PlanT>
+using enable_if_plan_t =
+    std::enable_if_t<std::is_base_of_v<LayeredPlanBase, PlanT> ||
+                         std::is_base_of_v<CombinedLayeredPlanBase, PlanT>,
+                     int>;
+} // namespace detail
+
+/**
+ * Dry run: Returns the footprint of Storage(size, resource) without allocating, e.g.
+ * estimateFootprint<MultiStorage<DataLayout::SoA, dofs, material>>(layout.back()).
+ */
+template <typename Storage>
+MemoryFootprint estimateFootprint(std::size_t size,
+                                  std::pmr::memory_resource* resource = nullptr) {
+    return detail::makeFootprint(static_cast<Storage const*>(nullptr), size, size, resource);
+}
+
+/**
+ * Dry run: Returns the footprint of Storage(plan, resource) including the per-layer and
+ * per-cluster breakdown without allocating.
+ */
+template <typename Storage, typename PlanT, detail::enable_if_plan_t<PlanT> = 0>
+MemoryFootprint estimateFootprint(PlanT const& plan,
+                                  std::pmr::memory_resource* resource = nullptr) {
+    const auto size = plan.getLayout().back();
+    auto result =
+        detail::makeFootprint(static_cast<Storage const*>(nullptr), size, size, resource);
+    detail::addLayers(result, plan, detail::entryBytes(result));
+    return result;
+}
+
+template <typename Storage> MemoryFootprint footprint(Storage const& storage) {
+    return detail::makeFootprint(&storage, storage.size(), storage.capacity(),
+                                 storage.memoryResource());
+}
+
+/**
+ * Returns the footprint of an allocated storage with the per-layer and per-cluster breakdown of
+ * a plan that matches the storage.
+ */
+template <typename Storage, typename PlanT, detail::enable_if_plan_t<PlanT> = 0>
+MemoryFootprint footprint(Storage const& storage, PlanT const& plan) {
+    auto result = footprint(storage);
+    detail::addLayers(result, plan, detail::entryBytes(result));
+    return result;
+}
+
+inline std::ostream& operator<<(std::ostream& os, MemoryFootprint const& footprint) {
+    os << "Memory footprint: " << footprint.totalBytes << " bytes for " << footprint.numEntries
+       << " entries (capacity " << footprint.capacity << ")\n";
+    os << "  payload " << footprint.payloadBytes << ", unused capacity "
+       << footprint.unusedCapacityBytes << ", padding " << footprint.paddingBytes << '\n';
+    for (auto const& id : footprint.ids) {
+        os << "  id " << id.name << ": " << id.bytes << '\n';
+    }
+    for (auto const& layer : footprint.layers) {
+        os << "  cluster " << layer.clusterId << " layer " << layer.name << ": "
+           << layer.numElements << " elements, " << layer.numEntries << " entries, "
+           << layer.bytes << '\n';
+    }
+    for (std::size_t clusterId = 0; clusterId < footprint.clusterBytes.size(); ++clusterId) {
+        os << "  cluster " << clusterId << ": " << footprint.clusterBytes[clusterId] << '\n';
+    }
+    return os;
+}
+
+} // namespace mneme
+
+#endif // MNEME_FOOTPRINT_H_
@@ -0,0 +1,268 @@
+#ifndef MNEME_HALO_H_
+#define MNEME_HALO_H_
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "span.hpp"
+#include "storage.hpp"
+
+namespace mneme {
+
+/**
+ * In-process transport that delivers every send to the receive with the same tag on wait().
+ * Use it to test halo exchanges without MPI.
+ *
+ * A transport provides send(tag, span<std::byte const>), receive(tag, span<std::byte>) and wait().
+ * Buffers passed to send and receive must stay valid until wait() returns, e.g. an MPI transport
+ * maps them to MPI_Isend, MPI_Irecv and MPI_Waitall.
+ */
+class LoopbackTransport {
+public:
+    void send(std::size_t tag, span<std::byte const> buffer) { sends.emplace(tag, buffer); }
+    void receive(std::size_t tag, span<std::byte> buffer) { receives.emplace(tag, buffer); }
+
+    void wait() {
+        if (sends.size() != receives.size()) {
+            throw std::runtime_error("Unmatched halo messages.");
+        }
+        for (auto& [tag, recvBuffer] : receives) {
+            const auto it = sends.find(tag);
+            if (it == sends.end() || it->second.size() != recvBuffer.size()) {
+                throw std::runtime_error("Unmatched halo messages.");
+            }
+            if (recvBuffer.size() > 0) {
+                std::memmove(recvBuffer.data(), it->second.data(), recvBuffer.size());
+            }
+        }
+        sends.clear();
+        receives.clear();
+    }
+
+private:
+    std::map<std::size_t, span<std::byte const>> sends;
+    std::map<std::size_t, span<std::byte>> receives;
+};
+
+/**
+ * Packs the selected Ids of SendLayer (usually Copy) into one contiguous buffer per Id and unpacks
+ * received buffers into RecvLayer (usually Ghost), e.g.
+ *
+ * auto halo = HaloExchange<Copy, Ghost, dofs, material>(plan);
+ * halo.exchange(storage, transport);
+ *
+ * Message tag i carries the i-th selected Id. If a layer is a single contiguous entry range and
+ * the storage uses a SoA layout, pack() returns spans into the storage and received data is
+ * written straight into it. Otherwise the entries are gathered into (scattered from) buffers
+ * owned by the exchange, which are reused across calls.
+ */
+template <typename SendLayer, typename RecvLayer, typename... SelectedIds> class HaloExchange {
+public:
+    constexpr static std::size_t numIds = sizeof...(SelectedIds);
+    using send_buffers_t = std::array<span<std::byte const>, numIds>;
+    using recv_buffers_t = std::array<span<std::byte>, numIds>;
+
+    static_assert((std::is_trivially_copyable_v<typename SelectedIds::type> && ...),
+                  "Halo exchange requires trivially copyable types.");
+
+    /**
+     * Collects the entry ranges of both layers from a LayeredPlan or CombinedLayeredPlan; with
+     * clusters, the ranges of all clusters are packed back to back.
+     */
+    template <typename PlanT> explicit HaloExchange(PlanT const& plan) {
+        const auto& layout = plan.getLayout();
+        plan.forEachLayer([&](auto const& layer) {
+            using layer_t = std::decay_t<decltype(layer)>;
+            const auto range =
+                std::make_pair(layout[layer.offset], layout[layer.offset + layer.numElements]);
+            if constexpr (std::is_same_v<layer_t, SendLayer>) {
+                addRange(sendRanges, range);
+            }
+            if constexpr (std::is_same_v<layer_t, RecvLayer>) {
+                addRange(recvRanges, range);
+            }
+        });
+        numSendEntries = countEntries(sendRanges);
+        numRecvEntries = countEntries(recvRanges);
+    }
+
+    std::size_t sendSize() const noexcept { return numSendEntries; }
+    std::size_t recvSize() const noexcept { return numRecvEntries; }
+
+    /**
+     * Returns one contiguous buffer per selected Id holding the SendLayer entries.
+     */
+    template <typename Storage> send_buffers_t pack(Storage const& storage) {
+        checkSize(storage);
+        return packAll(storage, std::index_sequence_for<SelectedIds...>());
+    }
+
+    /**
+     * Returns one buffer per selected Id that receives the RecvLayer entries.
+     * Call unpack(storage) after the data has arrived.
+     */
+    template <typename Storage> recv_buffers_t receiveBuffers(Storage& storage) {
+        checkSize(storage);
+        return receiveAll(storage, std::index_sequence_for<SelectedIds...>());
+    }
+
+    /**
+     * Scatters the received buffers into the RecvLayer; a no-op if data was received in place.
+     */
+    template <typename Storage> void unpack(Storage& storage) {
+        checkSize(storage);
+        std::size_t idNo = 0;
+        (unpackField<SelectedIds>(storage, recvBuffers[idNo++]), ...);
+    }
+
+    /**
+     * Posts all sends and receives on the transport, waits and unpacks.
+     */
+    template <typename Storage, typename Transport>
+    void exchange(Storage& storage, Transport& transport) {
+        const auto send = pack(storage);
+        const auto recv = receiveBuffers(storage);
+        for (std::size_t idNo = 0; idNo < numIds; ++idNo) {
+            transport.receive(idNo, recv[idNo]);
+        }
+        for (std::size_t idNo = 0; idNo < numIds; ++idNo) {
+            transport.send(idNo, send[idNo]);
+        }
+        transport.wait();
+        unpack(storage);
+    }
+
+private:
+    using ranges_t = std::vector<std::pair<std::size_t, std::size_t>>;
+
+    static void addRange(ranges_t& ranges, std::pair<std::size_t, std::size_t> range) {
+        if (!ranges.empty() && ranges.back().second == range.first) {
+            ranges.back().second = range.second;
+        } else if (range.first != range.second) {
+            ranges.push_back(range);
+        }
+    }
+
+    static std::size_t countEntries(ranges_t const& ranges) {
+        std::size_t count = 0;
+        for (auto const& [from, to] : ranges) {
+            count += to - from;
+        }
+        return count;
+    }
+
+    template <typename Storage> static constexpr bool isSoA() {
+        return Storage::dataLayout == DataLayout::SoA ||
+               Storage::dataLayout == DataLayout::SoAArena;
+    }
+
+    template <typename Storage> void checkSize(Storage const& storage) const {
+        const auto last = [](ranges_t const& ranges) {
+            return ranges.empty() ? std::size_t(0) : ranges.back().second;
+        };
+        if (storage.size() < std::max(last(sendRanges), last(recvRanges))) {
+            throw std::invalid_argument("Storage does not match the layout of the plan.");
+        }
+    }
+
+    template <typename Storage, std::size_t... IdNos>
+    send_buffers_t packAll(Storage const& storage, std::index_sequence<IdNos...>) {
+        return send_buffers_t{packField<SelectedIds>(storage, sendBuffers[IdNos])...};
+    }
+
+    template <typename Storage, std::size_t... IdNos>
+    recv_buffers_t receiveAll(Storage& storage, std::index_sequence<IdNos...>) {
+        return recv_buffers_t{recvField<SelectedIds>(storage, recvBuffers[IdNos])...};
+    }
+
+    template <typename Id, typename Storage>
+    span<std::byte const> packField(Storage const& storage, std::vector<std::byte>& buffer) {
+        using T = typename Id::type;
+        using allocate_policy_t = typename Storage::allocate_policy_t;
+        if constexpr (isSoA<Storage>()) {
+            if (sendRanges.size() == 1) {
+                const auto* ptr =
+                    allocate_policy_t::template address<Id>(storage.data(), sendRanges[0].first);
+                return {reinterpret_cast<std::byte const*>(ptr), numSendEntries * sizeof(T)};
+            }
+        }
+        buffer.resize(numSendEntries * sizeof(T));
+        auto* out = buffer.data();
+        for (auto const& [from, to] : sendRanges) {
+            if constexpr (isSoA<Storage>()) {
+                const auto numBytes = (to - from) * sizeof(T);
+                std::memcpy(out, allocate_policy_t::template address<Id>(storage.data(), from),
+                            numBytes);
+                out += numBytes;
+            } else {
+                for (auto pos = from; pos < to; ++pos) {
+                    std::memcpy(out, allocate_policy_t::template address<Id>(storage.data(), pos),
+                                sizeof(T));
+                    out += sizeof(T);
+                }
+            }
+        }
+        return {buffer.data(), buffer.size()};
+    }
+
+    template <typename Id, typename Storage>
+    span<std::byte> recvField(Storage& storage, std::vector<std::byte>& buffer) {
+        using T = typename Id::type;
+        using allocate_policy_t = typename Storage::allocate_policy_t;
+        if (receivesInPlace<Storage>()) {
+            auto* ptr =
+                allocate_policy_t::template address<Id>(storage.data(), recvRanges[0].first);
+            return {reinterpret_cast<std::byte*>(ptr), numRecvEntries * sizeof(T)};
+        }
+        buffer.resize(numRecvEntries * sizeof(T));
+        return {buffer.data(), buffer.size()};
+    }
+
+    template <typename Id, typename Storage>
+    void unpackField(Storage& storage, std::vector<std::byte> const& buffer) {
+        using T = typename Id::type;
+        using allocate_policy_t = typename Storage::allocate_policy_t;
+        if (receivesInPlace<Storage>()) {
+            return;
+        }
+        if (buffer.size() != numRecvEntries * sizeof(T)) {
+            throw std::logic_error("unpack() requires receiveBuffers() to be called first.");
+        }
+        const auto* in = buffer.data();
+        for (auto const& [from, to] : recvRanges) {
+            if constexpr (isSoA<Storage>()) {
+                const auto numBytes = (to - from) * sizeof(T);
+                std::memcpy(allocate_policy_t::template address<Id>(storage.data(), from), in,
+                            numBytes);
+                in += numBytes;
+            } else {
+                for (auto pos = from; pos < to; ++pos) {
+                    std::memcpy(allocate_policy_t::template address<Id>(storage.data(), pos), in,
+                                sizeof(T));
+                    in += sizeof(T);
+                }
+            }
+        }
+    }
+
+    template <typename Storage> bool receivesInPlace() const {
+        return isSoA<Storage>() && recvRanges.size() == 1;
+    }
+
+    ranges_t sendRanges;
+    ranges_t recvRanges;
+    std::size_t numSendEntries = 0;
+    std::size_t numRecvEntries = 0;
+    std::array<std::vector<std::byte>, numIds> sendBuffers;
+    std::array<std::vector<std::byte>, numIds> recvBuffers;
+};
+
+} // namespace mneme
+
+#endif // MNEME_HALO_H_
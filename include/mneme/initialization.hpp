@@ -0,0 +1,88 @@
+#ifndef MNEME_INITIALIZATION_H_
+#define MNEME_INITIALIZATION_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+namespace mneme {
+
+/**
+ * Initialization policies decide how a storage constructs the entries of an Id.
+ * An Id selects its policy with a member type, e.g.
+ * struct dofs {
+ *     using type = double;
+ *     using initialization = ValueInitialization;
+ * };
+ * Ids without a policy are left uninitialized if their type is trivially default constructible
+ * and are value-initialized otherwise. Storages still write one byte per page of uninitialized
+ * Ids from the constructing thread, such that first-touch NUMA placement follows the parallel
+ * construction. If a policy throws, the storage destroys the entries it has constructed so far
+ * and rethrows.
+ */
+struct NoInitialization {
+    template <typename T> static void construct(T*, std::size_t) noexcept {}
+};
+
+struct ValueInitialization {
+    template <typename T> static void construct(T* ptr, std::size_t) {
+        ::new (static_cast<void*>(ptr)) T();
+    }
+};
+
+/**
+ * Constructs entry pos from Func{}(pos), where pos is the entry's position in the storage.
+ */
+template <typename Func> struct FunctorInitialization {
+    template <typename T> static void construct(T* ptr, std::size_t pos) {
+        ::new (static_cast<void*>(ptr)) T(Func{}(pos));
+    }
+};
+
+namespace detail {
+template <typename, typename = void> inline constexpr bool hasInitializationDefined = false;
+
+template <typename T>
+inline constexpr bool
+    hasInitializationDefined<T, std::void_t<decltype(sizeof(typename T::initialization))>> = true;
+} // namespace detail
+
+template <typename Id> struct InitializationGetter {
+    constexpr static auto makeInitialization() {
+        if constexpr (detail::hasInitializationDefined<Id>) {
+            return typename Id::initialization();
+        } else if constexpr (std::is_trivially_default_constructible_v<typename Id::type>) {
+            return NoInitialization();
+        } else {
+            return ValueInitialization();
+        }
+    }
+    using type = decltype(makeInitialization());
+
+    static_assert(!std::is_same_v<type, NoInitialization> ||
+                      std::is_trivially_default_constructible_v<typename Id::type>,
+                  "NoInitialization requires a trivially default constructible type.");
+};
+
+/**
+ * Initialization of a Group: Every grouped Id is initialized according to its own policy.
+ */
+template <typename... Ids> struct GroupInitialization {
+    template <typename T> static void construct(T* ptr, std::size_t pos) {
+        ::new (static_cast<void*>(ptr)) T;
+        (initializeMember<Ids>(ptr->template get<Ids>(), pos), ...);
+    }
+
+private:
+    template <typename Id, typename U> static void initializeMember(U& member, std::size_t pos) {
+        using initialization_t = typename InitializationGetter<Id>::type;
+        if constexpr (!std::is_same_v<initialization_t, NoInitialization>) {
+            member.~U();
+            initialization_t::construct(&member, pos);
+        }
+    }
+};
+
+} // namespace mneme
+
+#endif // MNEME_INITIALIZATION_H_
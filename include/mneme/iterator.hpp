@@ -9,46 +9,70 @@
 
 namespace mneme {
 
+/**
+ * Random-access iterator that accesses the elements of Container through operator[].
+ * Iterators of the same container compare by position.
+ */
 template <typename Container> class Iterator {
 public:
-    using iterator_category = std::bidirectional_iterator_tag;
+    using iterator_category = std::random_access_iterator_tag;
     using access_type = decltype(std::declval<Container>().operator[](0));
-    using value_type = std::remove_reference_t<access_type>;
+    using value_type = std::remove_cv_t<std::remove_reference_t<access_type>>;
     using difference_type = std::ptrdiff_t;
-    using pointer = value_type*;
-    using reference = value_type&;
+    using pointer = std::remove_reference_t<access_type>*;
+    using reference = access_type;
 
+    Iterator() = default;
     Iterator(Container* container, std::size_t position = 0)
         : container(container), pos(position) {}
 
-    bool operator!=(Iterator const& other) {
-        return pos != other.pos || container != other.container;
+    bool operator==(Iterator const& other) const noexcept {
+        return pos == other.pos && container == other.container;
     }
-    bool operator==(Iterator const& other) { return !(*this != other); }
+    bool operator!=(Iterator const& other) const noexcept { return !(*this == other); }
+    bool operator<(Iterator const& other) const noexcept { return pos < other.pos; }
+    bool operator>(Iterator const& other) const noexcept { return other < *this; }
+    bool operator<=(Iterator const& other) const noexcept { return !(other < *this); }
+    bool operator>=(Iterator const& other) const noexcept { return !(*this < other); }
 
-    Iterator& operator++() {
+    Iterator& operator++() noexcept {
         ++pos;
         return *this;
     }
-    Iterator& operator--() {
+    Iterator& operator--() noexcept {
         --pos;
         return *this;
     }
-    Iterator operator++(int) {
-        Iterator copy(container, pos);
+    Iterator operator++(int) noexcept {
+        Iterator copy(*this);
         ++pos;
         return copy;
     }
-    Iterator operator--(int) {
-        Iterator copy(container, pos);
+    Iterator operator--(int) noexcept {
+        Iterator copy(*this);
         --pos;
         return copy;
     }
+    Iterator& operator+=(difference_type n) noexcept {
+        pos += n;
+        return *this;
+    }
+    Iterator& operator-=(difference_type n) noexcept {
+        pos -= n;
+        return *this;
+    }
+    Iterator operator+(difference_type n) const noexcept { return Iterator(container, pos + n); }
+    Iterator operator-(difference_type n) const noexcept { return Iterator(container, pos - n); }
+    friend Iterator operator+(difference_type n, Iterator const& it) noexcept { return it + n; }
+    difference_type operator-(Iterator const& other) const noexcept {
+        return static_cast<difference_type>(pos) - static_cast<difference_type>(other.pos);
+    }
 
-    access_type operator*() { return (*container)[pos]; }
+    access_type operator*() const { return (*container)[pos]; }
+    access_type operator[](difference_type n) const { return (*container)[pos + n]; }
 
 private:
-    Container* const container = nullptr;
+    Container* container = nullptr;
     std::size_t pos = std::numeric_limits<std::size_t>::max();
 };
 
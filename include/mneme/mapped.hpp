@@ -0,0 +1,413 @@
+#ifndef MNEME_MAPPED_H_
+#define MNEME_MAPPED_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "displacements.hpp"
+#include "iterator.hpp"
+#include "storage.hpp"
+#include "util.hpp"
+
+namespace mneme {
+
+enum class MapMode {
+    // Writes go to the file.
+    Shared,
+    // Writes are private to the process (copy-on-write), the file is left untouched.
+    Private
+};
+
+namespace detail {
+struct MappedStorageHeader {
+    char magic[8];
+    std::uint64_t version;
+    std::uint64_t dataLayout;
+    std::uint64_t idSignature;
+    std::uint64_t size;
+    std::uint64_t layoutSize;
+    std::uint64_t dataOffset;
+    std::uint64_t dataBytes;
+};
+
+constexpr char mappedStorageMagic[8] = {'M', 'N', 'E', 'M', 'E', 'M', 'A', 'P'};
+constexpr std::uint64_t mappedStorageVersion = 1;
+
+/**
+ * Describes how the entries of a data layout are placed in one contiguous buffer.
+ * SoA layouts use the layout of a single SoA arena.
+ */
+template <DataLayout TDataLayout, typename... Ids> struct MappedLayoutPolicy {
+    using allocate_policy_t = DataLayoutAllocatePolicy<TDataLayout, Ids...>;
+    using type = typename allocate_policy_t::type;
+    using arena_policy_t = DataLayoutAllocatePolicy<DataLayout::SoAArena, Ids...>;
+    constexpr static bool isSoA = TDataLayout == DataLayout::SoA ||
+                                  TDataLayout == DataLayout::SoAArena;
+
+    constexpr static std::size_t alignment() {
+        if constexpr (isSoA) {
+            return arena_policy_t::arenaAlignment;
+        } else if constexpr (TDataLayout == DataLayout::AoS) {
+            return alignof(tagged_tuple<Ids...>);
+        } else {
+            return alignof(typename allocate_policy_t::block_type);
+        }
+    }
+
+    /**
+     * Lower bound of the bytes per entry, such that bytes(size) cannot overflow for any size up
+     * to the size of a file divided by it.
+     */
+    constexpr static std::size_t entryBytes() {
+        if constexpr (isSoA) {
+            return (sizeof(typename Ids::type) + ... + 0);
+        } else if constexpr (TDataLayout == DataLayout::AoS) {
+            return sizeof(tagged_tuple<Ids...>);
+        } else {
+            using block_t = typename allocate_policy_t::block_type;
+            return std::max(std::size_t(1), sizeof(block_t) / blockWidth(TDataLayout));
+        }
+    }
+
+    static std::size_t bytes(std::size_t size) {
+        if constexpr (isSoA) {
+            return arena_policy_t::arenaLayout(size).back();
+        } else if constexpr (TDataLayout == DataLayout::AoS) {
+            return size * sizeof(tagged_tuple<Ids...>);
+        } else {
+            return allocate_policy_t::numBlocks(size) *
+                   sizeof(typename allocate_policy_t::block_type);
+        }
+    }
+
+    static type attach(std::byte* base, std::size_t size) {
+        if constexpr (isSoA) {
+            const auto offsets = arena_policy_t::arenaLayout(size);
+            type c;
+            std::size_t i = 0;
+            ((c.template get<Ids>() = reinterpret_cast<typename Ids::type*>(base + offsets[i++])),
+             ...);
+            return c;
+        } else if constexpr (TDataLayout == DataLayout::AoS) {
+            return reinterpret_cast<type>(base);
+        } else {
+            return type{reinterpret_cast<typename allocate_policy_t::block_type*>(base), 0};
+        }
+    }
+};
+
+[[noreturn]] inline void throwSystemError(std::string const& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+} // namespace detail
+
+/**
+ * Storage whose memory is a shared mapping of a file.
+ *
+ * The file starts with a header that records the data layout, a fingerprint of the Id set, the
+ * number of entries and optionally a Displacements layout, followed by the entries in the same
+ * layout a MultiStorage would use (SoA fields are laid out like in a SoAArena).
+ * Restarting from such a file only maps it, no data is read or converted:
+ *
+ * auto dofs = std::make_shared<MappedStorage<DataLayout::SoA, dofs>>("checkpoint.bin");
+ * auto view = StridedView<decltype(dofs)::element_type, 10>(dofs->layout(), dofs, 0, n);
+ *
+ * Only trivially copyable types can be stored and entries are never constructed or destroyed;
+ * a new file is zero-filled. Files are not portable across endianness or compilers.
+ */
+template <DataLayout TDataLayout, typename... Ids> class MappedStorage {
+public:
+    using allocate_policy_t = detail::DataLayoutAllocatePolicy<TDataLayout, Ids...>;
+    using mapped_policy_t = detail::MappedLayoutPolicy<TDataLayout, Ids...>;
+    constexpr static DataLayout dataLayout = TDataLayout;
+    using iterator = Iterator<MappedStorage<TDataLayout, Ids...>>;
+    using type = typename allocate_policy_t::type;
+    using offset_type = type;
+    using layout_t = Displacements<std::size_t>;
+
+    template <std::size_t Extent>
+    using access_policy_t = detail::DataLayoutAccessPolicy<TDataLayout, Extent, Ids...>;
+    template <std::size_t Extent> using value_type = typename access_policy_t<Extent>::value_type;
+
+    static_assert((std::is_trivially_copyable_v<typename Ids::type> && ...),
+                  "MappedStorage requires trivially copyable types.");
+
+    /**
+     * Creates (or truncates) the file at path and maps storage for size entries.
+     */
+    MappedStorage(std::string const& path, std::size_t size) {
+        create(path, size, static_cast<std::size_t const*>(nullptr), 0u);
+    }
+
+    /**
+     * Creates (or truncates) the file at path, stores the layout in its header and maps storage
+     * for layout.back() entries.
+     */
+    MappedStorage(std::string const& path, layout_t const& layout) {
+        create(path, layout.back(), layout.data(), layout.size() + 1);
+    }
+
+    template <typename PlanT,
+              typename std::enable_if_t<std::is_base_of_v<LayeredPlanBase, PlanT> ||
+                                            std::is_base_of_v<CombinedLayeredPlanBase, PlanT>,
+                                        int> = 0>
+    MappedStorage(std::string const& path, PlanT const& plan)
+        : MappedStorage(path, plan.getLayout()) {}
+
+    /**
+     * Maps an existing file. Throws if the file was written for a different data layout or Id set.
+     */
+    explicit MappedStorage(std::string const& path, MapMode mode = MapMode::Shared) {
+        open(path, mode);
+    }
+
+    ~MappedStorage() { unmap(); }
+
+    MappedStorage(MappedStorage&& other) noexcept { *this = std::move(other); }
+    MappedStorage& operator=(MappedStorage&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            fd = std::exchange(other.fd, -1);
+            mapping = std::exchange(other.mapping, nullptr);
+            mappingBytes = std::exchange(other.mappingBytes, 0u);
+            size_ = std::exchange(other.size_, 0u);
+            values = std::exchange(other.values, allocate_policy_t::null());
+        }
+        return *this;
+    }
+    MappedStorage(MappedStorage const& other) = delete;
+    MappedStorage& operator=(MappedStorage const& other) = delete;
+
+    value_type<1u> operator[](std::size_t pos) noexcept {
+        return access_policy_t<1u>::get(values, pos, pos + 1u);
+    }
+
+    const value_type<1u> operator[](std::size_t pos) const noexcept {
+        return access_policy_t<1u>::get(values, pos, pos + 1u);
+    }
+
+    template <std::size_t Extent = dynamic_extent>
+    value_type<Extent> get(offset_type& offset, std::size_t from, std::size_t to) noexcept {
+        return access_policy_t<Extent>::get(offset, from, to);
+    }
+
+    template <std::size_t Extent = dynamic_extent>
+    value_type<Extent> get(offset_type const& offset, std::size_t from,
+                           std::size_t to) const noexcept {
+        return access_policy_t<Extent>::get(offset, from, to);
+    }
+
+    offset_type offset(std::size_t from) { return allocate_policy_t::offset(values, from); }
+    type const& data() const noexcept { return values; }
+
+    inline std::size_t size() const noexcept { return size_; }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, size()); }
+
+    bool hasLayout() const noexcept { return header().layoutSize > 0; }
+
+    /**
+     * Returns the layout stored in the file header.
+     */
+    layout_t layout() const {
+        if (!hasLayout()) {
+            throw std::runtime_error("Mapped storage has no layout.");
+        }
+        const auto* displs = layoutData();
+        std::vector<std::size_t> count(header().layoutSize - 1);
+        for (std::size_t i = 0; i < count.size(); ++i) {
+            count[i] = displs[i + 1] - displs[i];
+        }
+        return layout_t(count);
+    }
+
+    /**
+     * Flushes the mapping to the file.
+     */
+    void sync() const {
+        if (msync(mapping, mappingBytes, MS_SYNC) != 0) {
+            detail::throwSystemError("msync failed");
+        }
+    }
+
+    /**
+     * Writes a copy of the storage, including its layout, to a fresh file and returns its mapping.
+     */
+    MappedStorage checkpoint(std::string const& path) const {
+        auto copy = MappedStorage(path, size_, hasLayout() ? layoutData() : nullptr,
+                                  header().layoutSize);
+        std::memcpy(copy.mapping + copy.header().dataOffset, mapping + header().dataOffset,
+                    header().dataBytes);
+        copy.sync();
+        return copy;
+    }
+
+private:
+    MappedStorage(std::string const& path, std::size_t size, std::uint64_t const* displs,
+                  std::size_t layoutSize) {
+        create(path, size, displs, layoutSize);
+    }
+
+    template <typename IntT>
+    void create(std::string const& path, std::size_t size, IntT const* displs,
+                std::size_t layoutSize) {
+        const auto pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        checkAlignment(pageSize);
+        detail::MappedStorageHeader head{};
+        std::copy(std::begin(detail::mappedStorageMagic), std::end(detail::mappedStorageMagic),
+                  head.magic);
+        head.version = detail::mappedStorageVersion;
+        head.dataLayout = static_cast<std::uint64_t>(TDataLayout);
+        head.idSignature = detail::idSignature<Ids...>();
+        head.size = size;
+        head.layoutSize = layoutSize;
+        const auto metaBytes = sizeof(head) + layoutSize * sizeof(std::uint64_t);
+        head.dataOffset = (metaBytes + pageSize - 1) / pageSize * pageSize;
+        head.dataBytes = mapped_policy_t::bytes(size);
+
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            detail::throwSystemError("Could not create " + path);
+        }
+        mappingBytes = head.dataOffset + head.dataBytes;
+        if (ftruncate(fd, static_cast<off_t>(mappingBytes)) != 0) {
+            unmap();
+            detail::throwSystemError("Could not resize " + path);
+        }
+        map(MapMode::Shared, path);
+        std::memcpy(mapping, &head, sizeof(head));
+        auto* layoutOut = reinterpret_cast<std::uint64_t*>(mapping + sizeof(head));
+        for (std::size_t i = 0; i < layoutSize; ++i) {
+            layoutOut[i] = displs[i];
+        }
+        size_ = size;
+        values = mapped_policy_t::attach(mapping + head.dataOffset, size);
+    }
+
+    void open(std::string const& path, MapMode mode) {
+        const auto pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        checkAlignment(pageSize);
+        fd = ::open(path.c_str(), mode == MapMode::Shared ? O_RDWR : O_RDONLY);
+        if (fd < 0) {
+            detail::throwSystemError("Could not open " + path);
+        }
+        struct stat fileStat {};
+        if (fstat(fd, &fileStat) != 0) {
+            unmap();
+            detail::throwSystemError("Could not stat " + path);
+        }
+        mappingBytes = static_cast<std::size_t>(fileStat.st_size);
+        if (mappingBytes < sizeof(detail::MappedStorageHeader)) {
+            unmap();
+            throw std::runtime_error(path + " is not a mapped storage.");
+        }
+        map(mode, path);
+        const auto& head = header();
+        auto fail = [&](std::string const& reason) {
+            unmap();
+            throw std::runtime_error(path + ": " + reason);
+        };
+        if (!std::equal(std::begin(detail::mappedStorageMagic),
+                        std::end(detail::mappedStorageMagic), head.magic)) {
+            fail("not a mapped storage");
+        }
+        if (head.version != detail::mappedStorageVersion) {
+            fail("unsupported version");
+        }
+        if (head.dataLayout != static_cast<std::uint64_t>(TDataLayout)) {
+            fail("data layout does not match");
+        }
+        if (head.idSignature != detail::idSignature<Ids...>()) {
+            fail("Ids do not match");
+        }
+        // Every bound is checked without overflow, as the header may be arbitrary.
+        constexpr auto headBytes = sizeof(detail::MappedStorageHeader);
+        if (head.dataOffset % pageSize != 0 || head.dataOffset < headBytes ||
+            head.dataOffset > mappingBytes ||
+            head.layoutSize > (head.dataOffset - headBytes) / sizeof(std::uint64_t) ||
+            head.size > mappingBytes / mapped_policy_t::entryBytes() ||
+            head.dataBytes != mapped_policy_t::bytes(head.size) ||
+            head.dataBytes > mappingBytes - head.dataOffset) {
+            fail("file is truncated or corrupt");
+        }
+        if (head.layoutSize > 0) {
+            const auto* displs = layoutData();
+            bool monotonic = displs[0] == 0;
+            for (std::size_t i = 1; i < head.layoutSize; ++i) {
+                monotonic = monotonic && displs[i - 1] <= displs[i];
+            }
+            if (!monotonic || displs[head.layoutSize - 1] != head.size) {
+                fail("layout is corrupt");
+            }
+        }
+        size_ = head.size;
+        values = mapped_policy_t::attach(mapping + head.dataOffset, size_);
+    }
+
+    void map(MapMode mode, std::string const& path) {
+        const auto flags = mode == MapMode::Shared ? MAP_SHARED : MAP_PRIVATE;
+        void* ptr = mmap(nullptr, mappingBytes, PROT_READ | PROT_WRITE, flags, fd, 0);
+        if (ptr == MAP_FAILED) {
+            const auto error = errno;
+            unmap();
+            errno = error;
+            detail::throwSystemError("Could not map " + path);
+        }
+        mapping = static_cast<std::byte*>(ptr);
+    }
+
+    void unmap() noexcept {
+        if (mapping != nullptr) {
+            munmap(mapping, mappingBytes);
+            mapping = nullptr;
+        }
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+        size_ = 0;
+        values = allocate_policy_t::null();
+    }
+
+    static void checkAlignment(std::size_t pageSize) {
+        if (mapped_policy_t::alignment() > pageSize) {
+            throw std::runtime_error("MappedStorage does not support alignments above page size.");
+        }
+    }
+
+    detail::MappedStorageHeader const& header() const noexcept {
+        return *reinterpret_cast<detail::MappedStorageHeader const*>(mapping);
+    }
+    std::uint64_t const* layoutData() const noexcept {
+        return reinterpret_cast<std::uint64_t const*>(mapping +
+                                                      sizeof(detail::MappedStorageHeader));
+    }
+
+    int fd = -1;
+    std::byte* mapping = nullptr;
+    std::size_t mappingBytes = 0u;
+    std::size_t size_ = 0u;
+    type values = allocate_policy_t::null();
+};
+
+template <typename Id>
+using MappedSingleStorage = SingleStorage<Id, MappedStorage<DataLayout::SoA, Id>>;
+
+} // namespace mneme
+
+#endif // MNEME_MAPPED_H_
@@ -0,0 +1,146 @@
+#ifndef MNEME_NUMA_H_
+#define MNEME_NUMA_H_
+
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "plan.hpp"
+
+namespace mneme {
+
+enum class NumaPolicy {
+    // Allocate on the given node if possible and fall back to other nodes otherwise.
+    Preferred,
+    // Allocate strictly on the given node.
+    Bind
+};
+
+inline std::size_t pageSize() noexcept {
+#ifdef __linux__
+    static const auto size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+/**
+ * Writes a zero byte to every page whose first byte lies in [begin, end), such that the pages
+ * are placed by the calling thread, as for bindToNumaNode. The bytes must not hold values yet.
+ */
+inline void touchPages(void* begin, void* end) noexcept {
+    const auto size = static_cast<std::uintptr_t>(pageSize());
+    const auto first = (reinterpret_cast<std::uintptr_t>(begin) + size - 1) / size * size;
+    const auto offset = first - reinterpret_cast<std::uintptr_t>(begin);
+    auto* bytes = static_cast<unsigned char*>(begin);
+    const auto numBytes = static_cast<std::size_t>(static_cast<unsigned char*>(end) - bytes);
+    for (auto i = static_cast<std::size_t>(offset); i < numBytes; i += size) {
+        bytes[i] = 0;
+    }
+}
+
+/**
+ * Binds all pages whose first byte lies in [begin, end) to the NUMA node.
+ * Pages are only placed on first touch, hence the memory should not have been touched before.
+ * Throws std::system_error if the kernel rejects the request.
+ */
+inline void bindToNumaNode(void const* begin, void const* end, int node,
+                           NumaPolicy policy = NumaPolicy::Preferred) {
+#ifdef __linux__
+    constexpr int mpolPreferred = 1;
+    constexpr int mpolBind = 2;
+    constexpr std::size_t bitsPerWord = sizeof(unsigned long) * CHAR_BIT;
+    if (node < 0) {
+        throw std::invalid_argument("NUMA node must be non-negative.");
+    }
+    const auto pageSize = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+    auto alignUp = [pageSize](std::uintptr_t addr) {
+        return (addr + pageSize - 1) / pageSize * pageSize;
+    };
+    const auto first = alignUp(reinterpret_cast<std::uintptr_t>(begin));
+    const auto last = alignUp(reinterpret_cast<std::uintptr_t>(end));
+    if (last <= first) {
+        return;
+    }
+    const auto nodeNo = static_cast<std::size_t>(node);
+    std::vector<unsigned long> nodeMask(nodeNo / bitsPerWord + 1, 0);
+    nodeMask[nodeNo / bitsPerWord] = 1UL << (nodeNo % bitsPerWord);
+    const auto mode = policy == NumaPolicy::Bind ? mpolBind : mpolPreferred;
+    // The kernel ignores the last bit of maxnode.
+    const auto maxNode = nodeMask.size() * bitsPerWord + 1;
+    const auto rc = syscall(SYS_mbind, reinterpret_cast<void*>(first), last - first, mode,
+                            nodeMask.data(), maxNode, 0U);
+    if (rc != 0) {
+        throw std::system_error(errno, std::generic_category(), "mbind failed");
+    }
+#else
+    (void)begin;
+    (void)end;
+    (void)node;
+    (void)policy;
+    throw std::runtime_error("NUMA placement is only supported on Linux.");
+#endif
+}
+
+/**
+ * Maps ranges [from, to) of storage entries to NUMA nodes.
+ * Pass it to the MultiStorage constructor to place the ranges before they are first touched.
+ */
+class NumaDomainMap {
+public:
+    struct Range {
+        std::size_t from;
+        std::size_t to;
+        int node;
+    };
+
+    explicit NumaDomainMap(NumaPolicy policy = NumaPolicy::Preferred) : policy_(policy) {}
+
+    NumaDomainMap& add(std::size_t from, std::size_t to, int node) {
+        if (to < from) {
+            throw std::invalid_argument("'To' must not be smaller than 'from'.");
+        }
+        ranges_.push_back(Range{from, to, node});
+        return *this;
+    }
+
+    /**
+     * Places the entries of cluster i of a CombinedLayeredPlan on node clusterToNode[i].
+     */
+    template <typename CombinedLayeredPlanT>
+    static NumaDomainMap fromClusters(CombinedLayeredPlanT const& plan,
+                                      std::vector<int> const& clusterToNode,
+                                      NumaPolicy policy = NumaPolicy::Preferred) {
+        if (clusterToNode.size() != plan.numberOfClusters()) {
+            throw std::invalid_argument("Need exactly one NUMA node per cluster.");
+        }
+        const auto& layout = plan.getLayout();
+        auto map = NumaDomainMap(policy);
+        for (std::size_t clusterId = 0; clusterId < clusterToNode.size(); ++clusterId) {
+            const auto [from, to] = plan.getClusterRange(clusterId);
+            map.add(layout[from], layout[to], clusterToNode[clusterId]);
+        }
+        return map;
+    }
+
+    std::vector<Range> const& ranges() const noexcept { return ranges_; }
+    NumaPolicy policy() const noexcept { return policy_; }
+
+private:
+    NumaPolicy policy_;
+    std::vector<Range> ranges_;
+};
+
+} // namespace mneme
+
+#endif // MNEME_NUMA_H_
@@ -0,0 +1,322 @@
+#ifndef MNEME_PARALLEL_H_
+#define MNEME_PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "storage.hpp"
+#include "tagged_tuple.hpp"
+#include "view.hpp"
+
+namespace mneme {
+
+/**
+ * Persistent worker threads. run(func) calls func(threadId) once on every thread, where the
+ * calling thread takes part as thread 0, and returns when all calls have finished.
+ * Exceptions thrown by func are rethrown by run. Calls of run from inside func execute
+ * serially on the calling thread.
+ */
+class ThreadPool {
+public:
+    explicit ThreadPool(std::size_t numThreads = defaultNumThreads()) {
+        numThreads = std::max(numThreads, std::size_t(1));
+        workers.reserve(numThreads - 1);
+        for (std::size_t threadId = 1; threadId < numThreads; ++threadId) {
+            workers.emplace_back([this, threadId] { work(threadId); });
+        }
+    }
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    std::size_t size() const noexcept { return workers.size() + 1; }
+
+    template <typename Func> void run(Func&& func) {
+        if (insideTask) {
+            for (std::size_t threadId = 0; threadId < size(); ++threadId) {
+                func(threadId);
+            }
+            return;
+        }
+        std::lock_guard<std::mutex> runLock(runMutex);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = &func;
+            invoke = [](void* f, std::size_t threadId) { (*static_cast<Func*>(f))(threadId); };
+            numBusy = workers.size();
+            error = nullptr;
+            ++generation;
+        }
+        wake.notify_all();
+        execute(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return numBusy == 0; });
+        task = nullptr;
+        if (error) {
+            std::rethrow_exception(std::exchange(error, nullptr));
+        }
+    }
+
+    static std::size_t defaultNumThreads() noexcept {
+        return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+private:
+    void work(std::size_t threadId) {
+        std::size_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stop || generation != seen; });
+                if (stop) {
+                    return;
+                }
+                seen = generation;
+            }
+            execute(threadId);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --numBusy;
+            }
+            done.notify_one();
+        }
+    }
+
+    void execute(std::size_t threadId) noexcept {
+        insideTask = true;
+        try {
+            invoke(task, threadId);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        insideTask = false;
+    }
+
+    inline static thread_local bool insideTask = false;
+
+    std::vector<std::thread> workers;
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    void* task = nullptr;
+    void (*invoke)(void*, std::size_t) = nullptr;
+    std::size_t generation = 0;
+    std::size_t numBusy = 0;
+    bool stop = false;
+    std::exception_ptr error;
+};
+
+/**
+ * Process-wide pool with ThreadPool::defaultNumThreads() threads, created on first use.
+ */
+inline ThreadPool& defaultThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+enum class Schedule {
+    // Every thread processes one contiguous range of chunks.
+    Static,
+    // Threads start on their static range and steal chunks from other threads when done.
+    Stealing
+};
+
+namespace detail {
+constexpr std::size_t cacheLineSize = 64;
+
+/**
+ * Number of consecutive entries of size bytes that fill whole cache lines.
+ */
+constexpr std::size_t lineGrain(std::size_t bytes) {
+    return cacheLineSize / std::gcd(cacheLineSize, bytes);
+}
+
+/**
+ * Number of consecutive entries after which every Id of the storage starts a new cache line
+ * (AoSoA: a new block), provided that the first entry does.
+ */
+template <DataLayout TDataLayout, typename... Ids>
+constexpr std::size_t entryGrain(MultiStorage<TDataLayout, Ids...> const*) {
+    if constexpr (isAoSoA(TDataLayout)) {
+        return blockWidth(TDataLayout);
+    } else if constexpr (TDataLayout == DataLayout::AoS) {
+        return lineGrain(sizeof(tagged_tuple<Ids...>));
+    } else {
+        std::size_t grain = 1;
+        ((grain = std::lcm(grain, lineGrain(sizeof(typename Ids::type)))), ...);
+        return grain;
+    }
+}
+constexpr std::size_t entryGrain(void const*) { return 1; }
+
+/**
+ * grain(view) is the number of elements per chunk and shift(view) the number of elements the
+ * first chunk is shortened by, such that chunk boundaries fall on storage entries that start
+ * cache lines, i.e. on multiples of entryGrain in absolute storage indices.
+ */
+template <typename View> struct ViewTraits {
+    constexpr static Schedule schedule = Schedule::Static;
+    static std::size_t grain(View const&) { return 1; }
+    static std::size_t shift(View const&) { return 0; }
+};
+
+template <typename Storage, std::size_t Stride> struct ViewTraits<StridedView<Storage, Stride>> {
+    constexpr static Schedule schedule = Schedule::Static;
+    constexpr static auto entries = entryGrain(static_cast<Storage const*>(nullptr));
+
+    static std::size_t grain(StridedView<Storage, Stride> const& view) {
+        const std::size_t stride = std::max(view.stride(), std::size_t(1));
+        return entries / std::gcd(entries, stride);
+    }
+    static std::size_t shift(StridedView<Storage, Stride> const& view) {
+        // Finds the first element that starts at a multiple of entries; if there is none, the
+        // boundaries cannot be aligned and are left relative to the first element.
+        const auto elementGrain = grain(view);
+        for (std::size_t i = 0; i < elementGrain; ++i) {
+            if ((view.firstEntry() + i * view.stride()) % entries == 0) {
+                return (elementGrain - i) % elementGrain;
+            }
+        }
+        return 0;
+    }
+};
+
+template <typename Storage, typename Offset> struct ViewTraits<GeneralView<Storage, Offset>> {
+    constexpr static Schedule schedule = Schedule::Stealing;
+    static std::size_t grain(GeneralView<Storage, Offset> const&) { return 1; }
+    static std::size_t shift(GeneralView<Storage, Offset> const&) { return 0; }
+};
+
+struct alignas(cacheLineSize) ChunkRange {
+    std::atomic<std::size_t> next{0};
+    std::size_t end = 0;
+};
+
+/**
+ * Like parallelFor, but the chunk boundaries are the indices i with (i + shift) % grain == 0,
+ * i.e. the first chunk is shortened by shift < grain.
+ */
+template <typename Func>
+void parallelForShifted(std::size_t size, Func&& func, std::size_t grain, std::size_t shift,
+                        Schedule schedule, ThreadPool& pool) {
+    const auto numChunks = (size + shift + grain - 1) / grain;
+    const auto numThreads = std::min(pool.size(), numChunks);
+    if (numThreads <= 1) {
+        for (std::size_t i = 0; i < size; ++i) {
+            func(i);
+        }
+        return;
+    }
+    auto runChunks = [&](std::size_t first, std::size_t last) {
+        const auto begin = std::max(first * grain, shift);
+        const auto end = std::min(last * grain, size + shift);
+        for (auto i = begin; i < end; ++i) {
+            func(i - shift);
+        }
+    };
+    if (schedule == Schedule::Static) {
+        pool.run([&](std::size_t threadId) {
+            if (threadId < numThreads) {
+                runChunks(threadId * numChunks / numThreads,
+                          (threadId + 1) * numChunks / numThreads);
+            }
+        });
+        return;
+    }
+    auto ranges = std::make_unique<detail::ChunkRange[]>(numThreads);
+    for (std::size_t threadId = 0; threadId < numThreads; ++threadId) {
+        ranges[threadId].next = threadId * numChunks / numThreads;
+        ranges[threadId].end = (threadId + 1) * numChunks / numThreads;
+    }
+    pool.run([&](std::size_t threadId) {
+        if (threadId >= numThreads) {
+            return;
+        }
+        for (std::size_t victim = 0; victim < numThreads; ++victim) {
+            auto& range = ranges[(threadId + victim) % numThreads];
+            for (auto chunk = range.next.fetch_add(1, std::memory_order_relaxed);
+                 chunk < range.end; chunk = range.next.fetch_add(1, std::memory_order_relaxed)) {
+                runChunks(chunk, chunk + 1);
+            }
+        }
+    });
+}
+} // namespace detail
+
+/**
+ * Calls func(i) for i in [0, size) on the pool. Chunk boundaries are multiples of grain, such
+ * that threads do not share the cache lines at chunk edges if grain elements fill whole lines.
+ */
+template <typename Func>
+void parallelFor(std::size_t size, Func&& func, std::size_t grain = 1,
+                 Schedule schedule = Schedule::Static, ThreadPool& pool = defaultThreadPool()) {
+    detail::parallelForShifted(size, std::forward<Func>(func), std::max(grain, std::size_t(1)), 0,
+                               schedule, pool);
+}
+
+/**
+ * Calls func(view[i]) for every element of a StridedView, DenseView or GeneralView on the pool.
+ * Strided views use static chunks aligned to the cache lines of the storage, counted from the
+ * start of the storage rather than of the view; general views default to work stealing as their
+ * elements differ in cost.
+ */
+template <typename View, typename Func>
+void parallelForEach(View& view, Func&& func,
+                     Schedule schedule = detail::ViewTraits<std::decay_t<View>>::schedule,
+                     ThreadPool& pool = defaultThreadPool()) {
+    using traits_t = detail::ViewTraits<std::decay_t<View>>;
+    detail::parallelForShifted(
+        view.size(), [&](std::size_t i) { func(view[i]); }, traits_t::grain(view),
+        traits_t::shift(view), schedule, pool);
+}
+
+/**
+ * Runs parallelForEach over the view of every layer in Layers, e.g.
+ *
+ * parallelForEach<Interior, Copy>(createViewFactory().withPlan(plan).withStorage(storage), f);
+ *
+ * The factory creates strided views if it has a stride and dense views otherwise.
+ */
+template <typename... Layers, typename Factory, typename Func,
+          typename std::enable_if_t<(sizeof...(Layers) > 0), int> = 0>
+void parallelForEach(Factory const& factory, Func&& func, ThreadPool& pool = defaultThreadPool()) {
+    auto forLayer = [&](auto layer) {
+        using layer_t = typename decltype(layer)::type;
+        auto layerFactory = factory;
+        if constexpr (Factory::hasStride) {
+            auto view = layerFactory.template createStridedView<layer_t>();
+            parallelForEach(view, func, detail::ViewTraits<decltype(view)>::schedule, pool);
+        } else {
+            auto view = layerFactory.template createDenseView<layer_t>();
+            parallelForEach(view, func, detail::ViewTraits<decltype(view)>::schedule, pool);
+        }
+    };
+    (forLayer(detail::identity<Layers>{}), ...);
+}
+
+} // namespace mneme
+
+#endif // MNEME_PARALLEL_H_
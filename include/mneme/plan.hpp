@@ -1,13 +1,22 @@
 #ifndef MNEME_PLAN_H_
 #define MNEME_PLAN_H_
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
 #include <memory>
 #include <numeric>
-#include <optional>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "displacements.hpp"
 #include "span.hpp"
 #include "tagged_tuple.hpp"
@@ -20,14 +29,163 @@ public:
     explicit Plan(std::size_t numElements) : dofs(numElements, 0) {}
 
     void setDof(std::size_t elementNo, std::size_t dof) { dofs[elementNo] = dof; }
+    std::size_t getDof(std::size_t elementNo) const { return dofs[elementNo]; }
+
+    /**
+     * Returns the number of dofs of every element in [first, first + count) if they are equal
+     * and dynamic_extent otherwise or if the range is empty.
+     */
+    std::size_t uniformDofs(std::size_t first, std::size_t count) const {
+        if (count == 0) {
+            return dynamic_extent;
+        }
+        const auto begin = dofs.begin() + first;
+        const auto end = begin + count;
+        const auto dof = *begin;
+        return std::all_of(begin, end, [dof](std::size_t d) { return d == dof; }) ? dof
+                                                                                   : dynamic_extent;
+    }
+
+    /**
+     * Sets the dofs of the elements starting at first to the values of a range, e.g. a span or a
+     * std::vector.
+     */
+    template <typename Range> void setDofs(std::size_t first, Range const& newDofs) {
+        std::copy(std::begin(newDofs), std::end(newDofs), dofs.begin() + first);
+    }
+
+    /**
+     * Sets the dofs of the elements [first, first + count) to func(i), i = 0, ..., count - 1.
+     */
+    template <typename Func> void fillDofs(std::size_t first, std::size_t count, Func const& func) {
+        for (std::size_t i = 0; i < count; ++i) {
+            dofs[first + i] = func(i);
+        }
+    }
+
+    /**
+     * Like fillDofs, but large ranges are filled with a static OpenMP schedule, hence func must
+     * be safe to call concurrently. If func throws, the first exception is rethrown after the
+     * parallel region.
+     */
+    template <typename Func>
+    void fillDofsParallel(std::size_t first, std::size_t count, Func const& func) {
+        [[maybe_unused]] const bool parallel = count >= parallelThreshold;
+        std::exception_ptr error;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) if (parallel)
+#endif
+        for (std::ptrdiff_t i = 0; i < static_cast<std::ptrdiff_t>(count); ++i) {
+            try {
+                dofs[first + i] = func(static_cast<std::size_t>(i));
+            } catch (...) {
+#ifdef _OPENMP
+#pragma omp critical(mneme_fill_dofs)
+#endif
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
 
     void resize(std::size_t newSize) { dofs.resize(newSize); }
+    [[nodiscard]] std::size_t size() const noexcept { return dofs.size(); }
+
+    /**
+     * Inserts elements with the given number of dofs before element pos.
+     */
+    void insert(std::size_t pos, std::vector<std::size_t> const& newDofs) {
+        dofs.insert(dofs.begin() + pos, newDofs.begin(), newDofs.end());
+    }
+
+    /**
+     * Removes the elements in the given ranges [from, to) in a single pass.
+     * The ranges have to be sorted and must not overlap.
+     */
+    void erase(std::vector<std::pair<std::size_t, std::size_t>> const& ranges) {
+        std::size_t write = 0;
+        std::size_t read = 0;
+        for (auto const& [from, to] : ranges) {
+            if (from < read || to < from || to > dofs.size()) {
+                throw std::invalid_argument("Erase ranges must be sorted, disjoint and valid.");
+            }
+            write = std::move(dofs.begin() + read, dofs.begin() + from, dofs.begin() + write) -
+                    dofs.begin();
+            read = to;
+        }
+        write = std::move(dofs.begin() + read, dofs.end(), dofs.begin() + write) - dofs.begin();
+        dofs.resize(write);
+    }
+
     [[nodiscard]] layout_t getLayout() const { return Displacements(dofs); }
 
+    /**
+     * Returns the total number of dofs, i.e. getLayout().back(), without building the layout.
+     */
+    [[nodiscard]] std::size_t numberOfDofs() const {
+        return detail::sumCounts(dofs.size(), [this](std::size_t p) { return dofs[p]; });
+    }
+
+    /**
+     * Like getLayout() but with 32-bit offsets if the total number of dofs fits.
+     */
+    [[nodiscard]] CompactDisplacements getCompactLayout() const {
+        return CompactDisplacements(
+            dofs.size(), [this](std::size_t p) { return dofs[p]; }, numberOfDofs());
+    }
+
+    /**
+     * Like getLayout() but stores runs of elements with equal dofs, e.g. uniform layers, as a
+     * single run.
+     */
+    [[nodiscard]] RunLengthDisplacements getRunLengthLayout() const {
+        return RunLengthDisplacements(dofs.size(), [this](std::size_t p) { return dofs[p]; });
+    }
+
 private:
+    constexpr static std::size_t parallelThreshold = std::size_t(1) << 16;
+
     std::vector<std::size_t> dofs;
 };
 
+namespace detail {
+/**
+ * Lazily built layout of a plan, which is safe to query from multiple threads as the pointer
+ * is only loaded and stored atomically. Concurrent first queries may each build the layout, but
+ * only one of them is published and returned to all callers.
+ */
+template <typename Layout> class LayoutCache {
+public:
+    LayoutCache() = default;
+    LayoutCache(LayoutCache const& other) : layout(std::atomic_load(&other.layout)) {}
+    LayoutCache& operator=(LayoutCache const& other) {
+        std::atomic_store(&layout, std::atomic_load(&other.layout));
+        return *this;
+    }
+
+    template <typename Builder> std::shared_ptr<const Layout> get(Builder const& build) const {
+        auto cached = std::atomic_load(&layout);
+        if (cached == nullptr) {
+            auto built = std::make_shared<const Layout>(build());
+            // On failure, cached is set to the layout published by another thread.
+            if (std::atomic_compare_exchange_strong(&layout, &cached, built)) {
+                cached = std::move(built);
+            }
+        }
+        return cached;
+    }
+
+    void reset() { std::atomic_store(&layout, std::shared_ptr<const Layout>()); }
+
+private:
+    mutable std::shared_ptr<const Layout> layout;
+};
+} // namespace detail
+
 class Layer {
 public:
     constexpr Layer() = default;
@@ -35,6 +193,11 @@ public:
         : numElements(numElements), offset(offset) {}
     std::size_t numElements = 0;
     std::size_t offset = 0;
+    // Number of dofs of every element if they are equal, dynamic_extent otherwise. Plans keep it
+    // up to date, such that strided views are created without scanning the layout.
+    std::size_t stride = dynamic_extent;
+
+    constexpr bool isUniform() const noexcept { return stride != dynamic_extent; }
 };
 
 class LayeredPlanBase {};
@@ -63,61 +226,215 @@ public:
 
     LayeredPlan(std::size_t curOffset, std::size_t numElements, Plan plan,
                 std::tuple<Layers...> layers)
-        : curOffset(curOffset), numElements(numElements), plan(std::move(plan)), layers(layers),
-          layout(std::nullopt) {}
-
-    template <typename OtherPlanT>
-    explicit LayeredPlan(OtherPlanT otherPlan) : plan(otherPlan.plan) {
-        this->curOffset = otherPlan.curOffset;
-        this->numElements = otherPlan.numElements;
-        this->plan = otherPlan.plan;
-        // Copy all entries of old tuple into new tuple.
-        std::apply(
-            [&](auto&&... args) {
-                (((std::get<typename std::remove_reference_t<std::remove_const_t<decltype(args)>>>(
-                      layers)) =
-                      std::get<typename std::remove_reference_t<decltype(args)>>(otherPlan.layers)),
-                 ...);
-            },
-            otherPlan.layers);
+        : curOffset(curOffset), numElements(numElements), plan(std::move(plan)), layers(layers) {}
+
+    /**
+     * Converts a plan with a prefix of Layers into a plan with all Layers, where the layers that
+     * are not part of the other plan are empty.
+     */
+    template <typename... OtherLayers>
+    explicit LayeredPlan(LayeredPlan<OtherLayers...> const& otherPlan)
+        : curOffset(otherPlan.curOffset), numElements(otherPlan.numElements),
+          plan(otherPlan.plan) {
+        copyLayers(otherPlan.layers);
     }
 
-    template <typename Layer, typename Func>
-    LayeredPlan<Layers..., Layer> withDofs(std::size_t numElementsLayer, Func func) const {
-        auto newPlan = LayeredPlan<Layers..., Layer>(*this);
-        auto& newLayer = std::get<Layer>(newPlan.layers);
-        newLayer.numElements = numElementsLayer;
-        newLayer.offset = curOffset;
-        const auto newCurOffset = curOffset + numElementsLayer;
-        const auto newNumElements = numElements + numElementsLayer;
-        newPlan.curOffset = newCurOffset;
-        newPlan.numElements = newNumElements;
-
-        newPlan.plan.resize(newNumElements);
-
-        for (std::size_t i = 0; i < newLayer.numElements; ++i) {
-            newPlan.plan.setDof(i + newLayer.offset, func(i));
-        }
-        return newPlan;
+    /**
+     * Like the converting copy constructor but takes over the dofs of the other plan.
+     */
+    template <typename... OtherLayers>
+    explicit LayeredPlan(LayeredPlan<OtherLayers...>&& otherPlan)
+        : curOffset(otherPlan.curOffset), numElements(otherPlan.numElements),
+          plan(std::move(otherPlan.plan)) {
+        copyLayers(otherPlan.layers);
     }
 
-    const layout_t& getLayout() const {
-        if (layout == std::nullopt) {
-            layout = plan.getLayout();
-        }
-        return *layout;
+    /**
+     * Returns a copy of this plan with the layer Layer of numElementsLayer elements appended,
+     * where element i of the layer has func(i) dofs. On temporaries, e.g. in a chain
+     * LayeredPlan().withDofs<A>(...).withDofs<B>(...), the dofs are moved along instead of
+     * copied.
+     */
+    template <typename Layer, typename Func,
+              typename std::enable_if_t<std::is_invocable_v<Func const&, std::size_t>, int> = 0>
+    LayeredPlan<Layers..., Layer> withDofs(std::size_t numElementsLayer, Func func) const& {
+        return LayeredPlan<Layers..., Layer>(*this).template appendLayer<Layer>(numElementsLayer,
+                                                                                 func);
+    }
+
+    template <typename Layer, typename Func,
+              typename std::enable_if_t<std::is_invocable_v<Func const&, std::size_t>, int> = 0>
+    LayeredPlan<Layers..., Layer> withDofs(std::size_t numElementsLayer, Func func) && {
+        return LayeredPlan<Layers..., Layer>(std::move(*this))
+            .template appendLayer<Layer>(numElementsLayer, func);
+    }
+
+    /**
+     * Like withDofs(numElementsLayer, func), but large layers are filled in parallel, hence func
+     * may be called concurrently, see Plan::fillDofsParallel.
+     */
+    template <typename Layer, typename Func,
+              typename std::enable_if_t<std::is_invocable_v<Func const&, std::size_t>, int> = 0>
+    LayeredPlan<Layers..., Layer> withDofsParallel(std::size_t numElementsLayer,
+                                                   Func func) const& {
+        return LayeredPlan<Layers..., Layer>(*this).template appendLayer<Layer>(
+            numElementsLayer, func, true);
+    }
+
+    template <typename Layer, typename Func,
+              typename std::enable_if_t<std::is_invocable_v<Func const&, std::size_t>, int> = 0>
+    LayeredPlan<Layers..., Layer> withDofsParallel(std::size_t numElementsLayer, Func func) && {
+        return LayeredPlan<Layers..., Layer>(std::move(*this))
+            .template appendLayer<Layer>(numElementsLayer, func, true);
+    }
+
+    /**
+     * Appends the layer Layer whose element i has layerDofs[i] dofs, e.g. for a span or a
+     * std::vector.
+     */
+    template <typename Layer, typename Range>
+    LayeredPlan<Layers..., Layer> withDofs(Range const& layerDofs) const& {
+        return LayeredPlan<Layers..., Layer>(*this).template appendLayer<Layer>(layerDofs);
+    }
+
+    template <typename Layer, typename Range>
+    LayeredPlan<Layers..., Layer> withDofs(Range const& layerDofs) && {
+        return LayeredPlan<Layers..., Layer>(std::move(*this))
+            .template appendLayer<Layer>(layerDofs);
+    }
+
+    const layout_t& getLayout() const { return *getSharedLayout(); }
+
+    /**
+     * Returns the cached layout, which is shared by copies of the plan and stays valid when the
+     * plan is modified afterwards, e.g. for views that outlive the plan. Safe to call
+     * concurrently, see detail::LayoutCache.
+     */
+    std::shared_ptr<const layout_t> getSharedLayout() const {
+        return layout.get([this] { return plan.getLayout(); });
+    }
+
+    [[nodiscard]] CompactDisplacements getCompactLayout() const { return plan.getCompactLayout(); }
+    [[nodiscard]] RunLengthDisplacements getRunLengthLayout() const {
+        return plan.getRunLengthLayout();
     }
 
     template <typename T> T getLayer() const { return std::get<T>(layers); }
+
+    /**
+     * Calls func(layer) for every layer in the order of Layers.
+     */
+    template <typename Func> void forEachLayer(Func&& func) const {
+        std::apply([&](auto const&... layer) { (func(layer), ...); }, layers);
+    }
+
+    std::size_t getDof(std::size_t elementNo) const { return plan.getDof(elementNo); }
+    [[nodiscard]] std::size_t numberOfDofs() const { return plan.numberOfDofs(); }
+
     std::size_t getOffset() const { return curOffset; }
     size_t size() const { return numElements; };
 
+    /**
+     * Inserts elements with the given number of dofs before element localPos of Layer.
+     * The offsets of all following layers are shifted accordingly.
+     */
+    template <typename Layer>
+    void insert(std::size_t localPos, std::vector<std::size_t> const& newDofs) {
+        const auto layer = getLayer<Layer>();
+        if (localPos > layer.numElements) {
+            throw std::out_of_range("Insert position exceeds layer size.");
+        }
+        plan.insert(layer.offset + localPos, newDofs);
+        updateLayers<Layer>(newDofs.size(), 0);
+        updateStride<Layer>();
+    }
+
+    /**
+     * Removes the element ranges [from, to) of Layer, where from and to are relative to the
+     * layer. The ranges have to be sorted and must not overlap.
+     */
+    template <typename Layer>
+    void erase(std::vector<std::pair<std::size_t, std::size_t>> const& localRanges) {
+        const auto layer = getLayer<Layer>();
+        std::vector<std::pair<std::size_t, std::size_t>> ranges;
+        ranges.reserve(localRanges.size());
+        std::size_t numRemoved = 0;
+        for (auto const& [from, to] : localRanges) {
+            if (to > layer.numElements || to < from) {
+                throw std::out_of_range("Erase range exceeds layer size.");
+            }
+            ranges.emplace_back(layer.offset + from, layer.offset + to);
+            numRemoved += to - from;
+        }
+        plan.erase(ranges);
+        updateLayers<Layer>(0, numRemoved);
+        updateStride<Layer>();
+    }
+
 private:
+    template <typename... OtherLayers>
+    void copyLayers(std::tuple<OtherLayers...> const& otherLayers) {
+        ((std::get<OtherLayers>(layers) = std::get<OtherLayers>(otherLayers)), ...);
+    }
+
+    template <typename Layer> void updateStride() {
+        auto& layer = std::get<Layer>(layers);
+        layer.stride = plan.uniformDofs(layer.offset, layer.numElements);
+    }
+
+    template <typename Layer> Layer& beginLayer(std::size_t numElementsLayer) {
+        auto& layer = std::get<Layer>(layers);
+        layer.numElements = numElementsLayer;
+        layer.offset = curOffset;
+        curOffset += numElementsLayer;
+        numElements += numElementsLayer;
+        plan.resize(numElements);
+        layout.reset();
+        return layer;
+    }
+
+    template <typename Layer, typename Func>
+    LayeredPlan&& appendLayer(std::size_t numElementsLayer, Func const& func,
+                              bool parallel = false) {
+        const auto& layer = beginLayer<Layer>(numElementsLayer);
+        if (parallel) {
+            plan.fillDofsParallel(layer.offset, numElementsLayer, func);
+        } else {
+            plan.fillDofs(layer.offset, numElementsLayer, func);
+        }
+        updateStride<Layer>();
+        return std::move(*this);
+    }
+
+    template <typename Layer, typename Range> LayeredPlan&& appendLayer(Range const& layerDofs) {
+        const auto& layer = beginLayer<Layer>(std::size(layerDofs));
+        plan.setDofs(layer.offset, layerDofs);
+        updateStride<Layer>();
+        return std::move(*this);
+    }
+
+    template <typename Layer> void updateLayers(std::size_t numAdded, std::size_t numRemoved) {
+        constexpr auto layerNo = static_cast<std::size_t>(detail::index_v<Layer, Layers...>);
+        std::size_t curLayerNo = 0;
+        auto update = [&](auto& layer) {
+            if (curLayerNo == layerNo) {
+                layer.numElements = layer.numElements + numAdded - numRemoved;
+            } else if (curLayerNo > layerNo) {
+                layer.offset = layer.offset + numAdded - numRemoved;
+            }
+            ++curLayerNo;
+        };
+        std::apply([&](auto&... layer) { (update(layer), ...); }, layers);
+        curOffset = curOffset + numAdded - numRemoved;
+        numElements = numElements + numAdded - numRemoved;
+        layout.reset();
+    }
+
     std::tuple<Layers...> layers;
     std::size_t curOffset = 0;
     std::size_t numElements = 0;
     Plan plan;
-    mutable std::optional<layout_t> layout;
+    detail::LayoutCache<layout_t> layout;
 };
 
 class CombinedLayeredPlanBase {};
@@ -136,31 +453,46 @@ public:
     using plan_t = LayeredPlan<Layers...>;
     using layout_t = Displacements<size_t>;
 
-    explicit CombinedLayeredPlan(std::vector<plan_t> plans) : plans(plans), offsets(plans.size()) {
+    explicit CombinedLayeredPlan(std::vector<plan_t> plans)
+        : plans(std::move(plans)), offsets(this->plans.size()) {
         std::size_t offset = 0;
-        for (std::size_t i = 0; i < plans.size(); ++i) {
-            const auto& plan = plans[i];
+        for (std::size_t i = 0; i < this->plans.size(); ++i) {
             offsets[i] = offset;
-            offset += plan.size();
+            offset += this->plans[i].size();
         }
     }
 
-    [[nodiscard]] layout_t getLayout() const {
-        const std::size_t totalNumberOfDofs =
-            std::accumulate(plans.begin(), plans.end(), 0U,
-                            [](auto count, auto& vec) { return count + vec.size(); });
+    const layout_t& getLayout() const { return *getSharedLayout(); }
 
-        std::vector<size_t> combinedDofs(totalNumberOfDofs);
-        std::size_t idx = 0;
-        for (auto i = 0U; i < plans.size(); ++i) {
-            const auto& plan = plans[i];
-            const auto& curLayout = plan.getLayout();
-            for (auto j = 0U; j < curLayout.size(); ++j) {
-                combinedDofs[idx] = curLayout.count(j);
-                ++idx;
-            }
-        }
-        return {combinedDofs};
+    /**
+     * Returns the cached combined layout, see LayeredPlan::getSharedLayout.
+     */
+    std::shared_ptr<const layout_t> getSharedLayout() const {
+        return layout.get([this] { return makeLayout<layout_t>(); });
+    }
+
+    /**
+     * Like getLayout() but with 32-bit offsets if the total number of dofs fits.
+     */
+    [[nodiscard]] CompactDisplacements getCompactLayout() const {
+        return makeLayout<CompactDisplacements>();
+    }
+
+    /**
+     * Like getLayout() but stores runs of elements with equal dofs, e.g. uniform layers, as a
+     * single run.
+     */
+    [[nodiscard]] RunLengthDisplacements getRunLengthLayout() const {
+        return makeLayout<RunLengthDisplacements>();
+    }
+
+    std::size_t numberOfClusters() const noexcept { return plans.size(); }
+
+    /**
+     * Returns the range [from, to) of elements that belong to cluster clusterId.
+     */
+    std::pair<std::size_t, std::size_t> getClusterRange(std::size_t clusterId) const {
+        return {offsets[clusterId], offsets[clusterId] + plans[clusterId].size()};
     }
 
     template <typename T> T getLayer(std::size_t clusterId) const {
@@ -170,9 +502,53 @@ public:
         return layer;
     }
 
+    /**
+     * Calls func(layer) for every layer of every cluster, where layer offsets are relative
+     * to the combined layout.
+     */
+    template <typename Func> void forEachLayer(Func&& func) const {
+        forEachClusterLayer([&](std::size_t, auto const& layer) { func(layer); });
+    }
+
+    /**
+     * Like forEachLayer but calls func(clusterId, layer).
+     */
+    template <typename Func> void forEachClusterLayer(Func&& func) const {
+        for (std::size_t clusterId = 0; clusterId < plans.size(); ++clusterId) {
+            plans[clusterId].forEachLayer([&](auto layer) {
+                layer.offset += offsets[clusterId];
+                func(clusterId, layer);
+            });
+        }
+    }
+
 private:
+    // Reads the dofs of the clusters through a generator instead of copying their layouts.
+    template <typename LayoutT> LayoutT makeLayout() const {
+        if (plans.empty()) {
+            return {};
+        }
+        const auto numElements = offsets.back() + plans.back().size();
+        const auto countOf = [&](std::size_t elementNo) {
+            const auto clusterId = static_cast<std::size_t>(
+                std::upper_bound(offsets.begin(), offsets.end(), elementNo) - offsets.begin() - 1);
+            return plans[clusterId].getDof(elementNo - offsets[clusterId]);
+        };
+        if constexpr (std::is_same_v<LayoutT, CompactDisplacements>) {
+            // The sum over the clusters' contiguous dofs saves a pass of cluster lookups.
+            std::uint64_t total = 0;
+            for (auto const& cluster : plans) {
+                total += cluster.numberOfDofs();
+            }
+            return LayoutT(numElements, countOf, total);
+        } else {
+            return LayoutT(numElements, countOf);
+        }
+    }
+
     std::vector<plan_t> plans;
     std::vector<std::size_t> offsets;
+    detail::LayoutCache<layout_t> layout;
 };
 } // namespace mneme
 
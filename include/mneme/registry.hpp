@@ -0,0 +1,48 @@
+#ifndef MNEME_REGISTRY_H_
+#define MNEME_REGISTRY_H_
+
+#include <atomic>
+#include <cstddef>
+
+namespace mneme {
+
+/**
+ * Process-wide totals of the memory held by all MultiStorages, including alignment padding and
+ * unused capacity. Updates are lock-free, hence the registry is always on.
+ */
+class MemoryRegistry {
+public:
+    static void add(std::size_t bytes) noexcept {
+        const auto live = liveBytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        auto peak = peakBytes_.load(std::memory_order_relaxed);
+        while (live > peak &&
+               !peakBytes_.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+        numAllocations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void remove(std::size_t bytes) noexcept {
+        liveBytes_.fetch_sub(bytes, std::memory_order_relaxed);
+        numAllocations_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    static std::size_t liveBytes() noexcept { return liveBytes_.load(std::memory_order_relaxed); }
+    static std::size_t peakBytes() noexcept { return peakBytes_.load(std::memory_order_relaxed); }
+    static std::size_t numAllocations() noexcept {
+        return numAllocations_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Restarts peak tracking from the current live total.
+     */
+    static void resetPeak() noexcept { peakBytes_.store(liveBytes(), std::memory_order_relaxed); }
+
+private:
+    inline static std::atomic<std::size_t> liveBytes_{0};
+    inline static std::atomic<std::size_t> peakBytes_{0};
+    inline static std::atomic<std::size_t> numAllocations_{0};
+};
+
+} // namespace mneme
+
+#endif // MNEME_REGISTRY_H_
@@ -0,0 +1,246 @@
+#ifndef MNEME_SCHEDULER_H_
+#define MNEME_SCHEDULER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "parallel.hpp"
+#include "plan.hpp"
+
+namespace mneme {
+
+/**
+ * Directed acyclic graph of tasks. A task may only depend on tasks that were added before it,
+ * hence the graph cannot contain cycles.
+ *
+ * run() executes the tasks on a thread pool. Every thread owns a queue of ready tasks and steals
+ * from the back of other threads' queues when its own is empty. Tasks that are ready at the
+ * start are handed out in the order they were added. A task that becomes ready is put at the
+ * front of the queue of the thread that finished its last dependency, i.e. chains of dependent
+ * tasks run back to back. Ready tasks of Priority::High share one queue, which every thread
+ * empties before it looks at its own; threads without work sleep until a task becomes ready.
+ */
+class TaskGraph {
+public:
+    using task_id = std::size_t;
+    enum class Priority { Normal, High };
+
+    task_id addTask(std::function<void()> work, std::initializer_list<task_id> dependencies = {},
+                    Priority priority = Priority::Normal) {
+        const auto id = tasks.size();
+        for (const auto dependency : dependencies) {
+            if (dependency >= id) {
+                throw std::invalid_argument("Tasks may only depend on previously added tasks.");
+            }
+        }
+        for (const auto dependency : dependencies) {
+            successors[dependency].push_back(id);
+        }
+        tasks.push_back(Task{std::move(work), dependencies.size(), priority});
+        successors.emplace_back();
+        return id;
+    }
+
+    std::size_t size() const noexcept { return tasks.size(); }
+
+    /**
+     * Runs every task once and returns when all tasks have finished. If a task throws, no further
+     * tasks are started and the exception is rethrown.
+     */
+    void run(ThreadPool& pool = defaultThreadPool()) {
+        if (tasks.empty()) {
+            return;
+        }
+        const auto numThreads = pool.size();
+        auto pending = std::make_unique<std::atomic<std::size_t>[]>(tasks.size());
+        // queues[numThreads] holds the ready tasks of high priority
+        auto queues = std::make_unique<Queue[]>(numThreads + 1);
+        auto& highPriority = queues[numThreads];
+        std::size_t numReady = 0;
+        for (task_id id = 0; id < tasks.size(); ++id) {
+            pending[id] = tasks[id].numDependencies;
+            if (tasks[id].numDependencies == 0) {
+                auto& queue = tasks[id].priority == Priority::High
+                                  ? highPriority
+                                  : queues[numReady++ % numThreads];
+                queue.tasks.push_back(id);
+            }
+        }
+        std::atomic<std::size_t> remaining = tasks.size();
+        std::atomic<bool> failed = false;
+        Idle idle;
+        idle.numQueued = numReady + highPriority.tasks.size();
+
+        pool.run([&](std::size_t threadId) {
+            auto done = [&] {
+                return remaining.load(std::memory_order_acquire) == 0 ||
+                       failed.load(std::memory_order_relaxed);
+            };
+            while (!done()) {
+                task_id id = 0;
+                if (!pop(queues.get(), numThreads, threadId, id, idle)) {
+                    std::unique_lock<std::mutex> lock(idle.mutex);
+                    idle.wakeUp.wait(lock, [&] { return idle.numQueued > 0 || done(); });
+                    continue;
+                }
+                try {
+                    tasks[id].work();
+                } catch (...) {
+                    failed = true;
+                    idle.notify(true);
+                    throw;
+                }
+                for (const auto successor : successors[id]) {
+                    if (pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        auto& queue = tasks[successor].priority == Priority::High
+                                          ? highPriority
+                                          : queues[threadId];
+                        ++idle.numQueued;
+                        {
+                            std::lock_guard<std::mutex> lock(queue.mutex);
+                            queue.tasks.push_front(successor);
+                        }
+                        idle.notify(false);
+                    }
+                }
+                if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    idle.notify(true);
+                }
+            }
+        });
+    }
+
+private:
+    struct Task {
+        std::function<void()> work;
+        std::size_t numDependencies;
+        Priority priority;
+    };
+
+    struct alignas(detail::cacheLineSize) Queue {
+        std::mutex mutex;
+        std::deque<task_id> tasks;
+    };
+
+    /**
+     * Counts the tasks in all queues; threads that find no task wait on wakeUp.
+     */
+    struct Idle {
+        std::mutex mutex;
+        std::condition_variable wakeUp;
+        std::atomic<std::size_t> numQueued = 0;
+
+        void notify(bool all) {
+            // Locking orders the notification after the waiter's check of its predicate
+            { std::lock_guard<std::mutex> lock(mutex); }
+            if (all) {
+                wakeUp.notify_all();
+            } else {
+                wakeUp.notify_one();
+            }
+        }
+    };
+
+    static bool takeFront(Queue& queue, task_id& id) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) {
+            return false;
+        }
+        id = queue.tasks.front();
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    static bool pop(Queue* queues, std::size_t numThreads, std::size_t threadId, task_id& id,
+                    Idle& idle) {
+        if (takeFront(queues[numThreads], id) || takeFront(queues[threadId], id)) {
+            --idle.numQueued;
+            return true;
+        }
+        for (std::size_t i = 1; i < numThreads; ++i) {
+            auto& victim = queues[(threadId + i) % numThreads];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                id = victim.tasks.back();
+                victim.tasks.pop_back();
+                --idle.numQueued;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<Task> tasks;
+    std::vector<std::vector<task_id>> successors;
+};
+
+/**
+ * Communication step that does nothing, e.g. for runs on a single rank.
+ * A communication step provides post(clusterId), which packs and sends the cluster's copy layer
+ * and posts the receives of its ghost layer, and wait(clusterId), which returns once the ghost
+ * layer has been received.
+ */
+struct NoCommunication {
+    void post(std::size_t) {}
+    void wait(std::size_t) {}
+};
+
+/**
+ * Builds the task graph of one step over all clusters of a CombinedLayeredPlan. Per cluster,
+ * compute(clusterId, layer) is called for CopyLayer, then the halo exchange is posted, and
+ * InteriorLayer is computed while the exchange is in flight. Once the interior is done, the
+ * exchange is waited for and GhostLayer is computed. The layer passed to compute has offsets
+ * relative to the combined layout. Copy layers and posts have Priority::High, hence the copy
+ * layers of all clusters are started before any interior layer.
+ *
+ * auto graph = makeClusterTaskGraph<Copy, Interior, Ghost>(plan, compute, communication);
+ * graph.run(pool);
+ *
+ * The plan, compute and communication are captured by reference and have to outlive the graph.
+ */
+template <typename CopyLayer, typename InteriorLayer, typename GhostLayer, typename... Layers,
+          typename Compute, typename Communication>
+TaskGraph makeClusterTaskGraph(CombinedLayeredPlan<Layers...> const& plan, Compute& compute,
+                               Communication& communication) {
+    TaskGraph graph;
+    const auto numClusters = plan.numberOfClusters();
+    auto computeLayer = [&plan, &compute](auto layerType, std::size_t clusterId) {
+        using layer_t = typename decltype(layerType)::type;
+        return [&plan, &compute, clusterId] {
+            compute(clusterId, plan.template getLayer<layer_t>(clusterId));
+        };
+    };
+    std::vector<TaskGraph::task_id> copies(numClusters);
+    for (std::size_t clusterId = 0; clusterId < numClusters; ++clusterId) {
+        copies[clusterId] = graph.addTask(computeLayer(detail::identity<CopyLayer>{}, clusterId),
+                                          {}, TaskGraph::Priority::High);
+    }
+    std::vector<TaskGraph::task_id> interiors(numClusters);
+    for (std::size_t clusterId = 0; clusterId < numClusters; ++clusterId) {
+        interiors[clusterId] =
+            graph.addTask(computeLayer(detail::identity<InteriorLayer>{}, clusterId));
+    }
+    for (std::size_t clusterId = 0; clusterId < numClusters; ++clusterId) {
+        const auto post = graph.addTask(
+            [&communication, clusterId] { communication.post(clusterId); }, {copies[clusterId]},
+            TaskGraph::Priority::High);
+        const auto wait = graph.addTask(
+            [&communication, clusterId] { communication.wait(clusterId); },
+            {post, interiors[clusterId]});
+        graph.addTask(computeLayer(detail::identity<GhostLayer>{}, clusterId), {wait});
+    }
+    return graph;
+}
+
+} // namespace mneme
+
+#endif // MNEME_SCHEDULER_H_
@@ -0,0 +1,414 @@
+#ifndef MNEME_SERIALIZATION_H_
+#define MNEME_SERIALIZATION_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "storage.hpp"
+#include "util.hpp"
+
+namespace mneme {
+
+/**
+ * Selects the layers that are serialized, e.g. LayerSelection<Interior, Copy>{}.
+ */
+template <typename... Layers> struct LayerSelection {};
+
+/**
+ * Selects the Ids that are serialized, e.g. IdSelection<dofs>{}.
+ */
+template <typename... Ids> struct IdSelection {};
+
+/**
+ * Stores chunks as they are.
+ */
+struct NoCompression {
+    constexpr static std::uint64_t id = 0;
+};
+
+/**
+ * Fast lossless compression for numerical fields: The bytes of a chunk are shuffled such that byte
+ * k of every value is stored contiguously (sign, exponent and high mantissa bytes of similar
+ * values are then mostly equal) and the result is run-length encoded.
+ * Works best for constant, zero or slowly varying fields.
+ * The shuffled bytes are kept in scratch, which callers reuse across chunks.
+ */
+struct ShuffleRleCompression {
+    constexpr static std::uint64_t id = 1;
+
+    static void compress(std::byte const* src, std::size_t numBytes, std::size_t valueSize,
+                         std::vector<std::byte>& out, std::vector<std::byte>& scratch) {
+        const auto numValues = numBytes / valueSize;
+        auto& shuffled = scratch;
+        shuffled.resize(numBytes);
+        for (std::size_t i = 0; i < numValues; ++i) {
+            for (std::size_t k = 0; k < valueSize; ++k) {
+                shuffled[k * numValues + i] = src[i * valueSize + k];
+            }
+        }
+        out.clear();
+        std::size_t pos = 0;
+        std::size_t literalStart = 0;
+        auto flushLiterals = [&](std::size_t end) {
+            while (literalStart < end) {
+                const auto count = std::min(end - literalStart, maxLiteral);
+                out.push_back(static_cast<std::byte>(count - 1));
+                out.insert(out.end(), shuffled.begin() + literalStart,
+                           shuffled.begin() + literalStart + count);
+                literalStart += count;
+            }
+        };
+        while (pos < numBytes) {
+            std::size_t run = 1;
+            while (pos + run < numBytes && run < maxRun && shuffled[pos + run] == shuffled[pos]) {
+                ++run;
+            }
+            if (run >= minRun) {
+                flushLiterals(pos);
+                out.push_back(static_cast<std::byte>(runFlag | (run - minRun)));
+                out.push_back(shuffled[pos]);
+                pos += run;
+                literalStart = pos;
+            } else {
+                pos += run;
+            }
+        }
+        flushLiterals(numBytes);
+    }
+
+    static void decompress(std::byte const* src, std::size_t numBytes, std::size_t valueSize,
+                           std::byte* dst, std::size_t dstBytes, std::vector<std::byte>& scratch) {
+        auto& shuffled = scratch;
+        shuffled.resize(dstBytes);
+        std::size_t in = 0;
+        std::size_t out = 0;
+        while (in < numBytes) {
+            const auto control = static_cast<std::size_t>(src[in++]);
+            if (control & runFlag) {
+                const auto count = (control & ~runFlag) + minRun;
+                if (in >= numBytes || out + count > dstBytes) {
+                    throw std::runtime_error("Corrupt compressed chunk.");
+                }
+                std::fill_n(shuffled.begin() + out, count, src[in++]);
+                out += count;
+            } else {
+                const auto count = control + 1;
+                if (in + count > numBytes || out + count > dstBytes) {
+                    throw std::runtime_error("Corrupt compressed chunk.");
+                }
+                std::copy_n(src + in, count, shuffled.begin() + out);
+                in += count;
+                out += count;
+            }
+        }
+        if (out != dstBytes) {
+            throw std::runtime_error("Corrupt compressed chunk.");
+        }
+        const auto numValues = dstBytes / valueSize;
+        for (std::size_t i = 0; i < numValues; ++i) {
+            for (std::size_t k = 0; k < valueSize; ++k) {
+                dst[i * valueSize + k] = shuffled[k * numValues + i];
+            }
+        }
+    }
+
+private:
+    constexpr static std::size_t runFlag = 0x80;
+    constexpr static std::size_t maxLiteral = 0x80;
+    constexpr static std::size_t minRun = 3;
+    constexpr static std::size_t maxRun = 0x7f + minRun;
+};
+
+namespace detail {
+constexpr char serializationMagic[8] = {'M', 'N', 'E', 'M', 'E', 'S', 'E', 'R'};
+constexpr std::uint64_t serializationVersion = 2;
+// Raw bytes per chunk; bounds the buffers needed for gathering and compression.
+constexpr std::size_t serializationChunkBytes = std::size_t(1) << 20;
+
+template <typename... SelectedLayers, typename PlanT>
+std::vector<std::pair<std::size_t, std::size_t>> selectedElementRanges(PlanT const& plan) {
+    std::vector<std::pair<std::size_t, std::size_t>> ranges;
+    plan.forEachLayer([&](auto const& layer) {
+        using layer_t = std::decay_t<decltype(layer)>;
+        if constexpr ((std::is_same_v<layer_t, SelectedLayers> || ...)) {
+            const auto from = layer.offset;
+            const auto to = layer.offset + layer.numElements;
+            // Adjacent layers, e.g. Interior and Copy, are written as one range.
+            if (!ranges.empty() && ranges.back().second == from) {
+                ranges.back().second = to;
+            } else if (from != to) {
+                ranges.emplace_back(from, to);
+            }
+        }
+    });
+    return ranges;
+}
+
+inline void writeWord(std::ostream& os, std::uint64_t value) {
+    os.write(reinterpret_cast<char const*>(&value), sizeof(value));
+}
+
+inline std::uint64_t readWord(std::istream& is) {
+    std::uint64_t value = 0;
+    if (!is.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+        throw std::runtime_error("Unexpected end of stream.");
+    }
+    return value;
+}
+
+template <typename Storage> constexpr bool isContiguous() {
+    return Storage::dataLayout == DataLayout::SoA || Storage::dataLayout == DataLayout::SoAArena;
+}
+
+/**
+ * Buffers that are reused for all chunks of a stream.
+ */
+struct SerializationBuffers {
+    // Values gathered from non-contiguous layouts and dof counts.
+    std::vector<std::byte> gathered;
+    std::vector<std::byte> compressed;
+    // Scratch space of the compressor.
+    std::vector<std::byte> scratch;
+};
+
+template <typename Compressor>
+void writeChunk(std::ostream& os, std::byte const* raw, std::size_t numBytes,
+                std::size_t valueSize, SerializationBuffers& buffers) {
+    writeWord(os, numBytes);
+    if constexpr (std::is_same_v<Compressor, NoCompression>) {
+        writeWord(os, numBytes);
+        os.write(reinterpret_cast<char const*>(raw), static_cast<std::streamsize>(numBytes));
+    } else {
+        Compressor::compress(raw, numBytes, valueSize, buffers.compressed, buffers.scratch);
+        writeWord(os, buffers.compressed.size());
+        os.write(reinterpret_cast<char const*>(buffers.compressed.data()),
+                 static_cast<std::streamsize>(buffers.compressed.size()));
+    }
+}
+
+template <typename Compressor>
+void readChunk(std::istream& is, std::byte* raw, std::size_t numBytes, std::size_t valueSize,
+               SerializationBuffers& buffers) {
+    const auto rawBytes = readWord(is);
+    const auto storedBytes = readWord(is);
+    // Bounds the worst-case expansion of the compressors.
+    if (rawBytes != numBytes || storedBytes > numBytes + numBytes / 64 + 64) {
+        throw std::runtime_error("Chunk does not match the storage.");
+    }
+    if constexpr (std::is_same_v<Compressor, NoCompression>) {
+        if (storedBytes != numBytes) {
+            throw std::runtime_error("Chunk does not match the storage.");
+        }
+        if (!is.read(reinterpret_cast<char*>(raw), static_cast<std::streamsize>(numBytes))) {
+            throw std::runtime_error("Unexpected end of stream.");
+        }
+    } else {
+        buffers.compressed.resize(storedBytes);
+        if (!is.read(reinterpret_cast<char*>(buffers.compressed.data()),
+                     static_cast<std::streamsize>(storedBytes))) {
+            throw std::runtime_error("Unexpected end of stream.");
+        }
+        Compressor::decompress(buffers.compressed.data(), storedBytes, valueSize, raw, numBytes,
+                               buffers.scratch);
+    }
+}
+
+constexpr std::size_t countChunkSize = serializationChunkBytes / sizeof(std::uint64_t);
+
+/**
+ * Writes the dof counts of the elements [from, to) in chunks through the compressor.
+ */
+template <typename Compressor, typename Layout>
+void writeCounts(std::ostream& os, Layout const& layout, std::size_t from, std::size_t to,
+                 SerializationBuffers& buffers) {
+    for (auto chunkFrom = from; chunkFrom < to; chunkFrom += countChunkSize) {
+        const auto count = std::min(countChunkSize, to - chunkFrom);
+        buffers.gathered.resize(count * sizeof(std::uint64_t));
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto dofs = static_cast<std::uint64_t>(layout.count(chunkFrom + i));
+            std::memcpy(buffers.gathered.data() + i * sizeof(dofs), &dofs, sizeof(dofs));
+        }
+        writeChunk<Compressor>(os, buffers.gathered.data(), buffers.gathered.size(),
+                               sizeof(std::uint64_t), buffers);
+    }
+}
+
+template <typename Compressor, typename Layout>
+void readCounts(std::istream& is, Layout const& layout, std::size_t from, std::size_t to,
+                SerializationBuffers& buffers) {
+    for (auto chunkFrom = from; chunkFrom < to; chunkFrom += countChunkSize) {
+        const auto count = std::min(countChunkSize, to - chunkFrom);
+        buffers.gathered.resize(count * sizeof(std::uint64_t));
+        readChunk<Compressor>(is, buffers.gathered.data(), buffers.gathered.size(),
+                              sizeof(std::uint64_t), buffers);
+        for (std::size_t i = 0; i < count; ++i) {
+            std::uint64_t dofs = 0;
+            std::memcpy(&dofs, buffers.gathered.data() + i * sizeof(dofs), sizeof(dofs));
+            if (dofs != layout.count(chunkFrom + i)) {
+                throw std::runtime_error("Serialized dofs do not match the plan.");
+            }
+        }
+    }
+}
+
+template <typename Id, typename Compressor, typename Storage>
+void writeField(std::ostream& os, Storage const& storage, std::size_t from, std::size_t to,
+                SerializationBuffers& buffers) {
+    using T = typename Id::type;
+    using allocate_policy_t = typename Storage::allocate_policy_t;
+    constexpr auto chunkSize = std::max(std::size_t(1), serializationChunkBytes / sizeof(T));
+    for (auto chunkFrom = from; chunkFrom < to; chunkFrom += chunkSize) {
+        const auto count = std::min(chunkSize, to - chunkFrom);
+        const auto numBytes = count * sizeof(T);
+        const std::byte* raw = nullptr;
+        if constexpr (isContiguous<Storage>()) {
+            raw = reinterpret_cast<std::byte const*>(
+                allocate_policy_t::template address<Id>(storage.data(), chunkFrom));
+        } else {
+            buffers.gathered.resize(numBytes);
+            for (std::size_t i = 0; i < count; ++i) {
+                std::memcpy(buffers.gathered.data() + i * sizeof(T),
+                            allocate_policy_t::template address<Id>(storage.data(), chunkFrom + i),
+                            sizeof(T));
+            }
+            raw = buffers.gathered.data();
+        }
+        writeChunk<Compressor>(os, raw, numBytes, sizeof(T), buffers);
+    }
+}
+
+template <typename Id, typename Compressor, typename Storage>
+void readField(std::istream& is, Storage& storage, std::size_t from, std::size_t to,
+               SerializationBuffers& buffers) {
+    using T = typename Id::type;
+    using allocate_policy_t = typename Storage::allocate_policy_t;
+    constexpr auto chunkSize = std::max(std::size_t(1), serializationChunkBytes / sizeof(T));
+    for (auto chunkFrom = from; chunkFrom < to; chunkFrom += chunkSize) {
+        const auto count = std::min(chunkSize, to - chunkFrom);
+        const auto numBytes = count * sizeof(T);
+        std::byte* raw = nullptr;
+        if constexpr (isContiguous<Storage>()) {
+            raw = reinterpret_cast<std::byte*>(
+                allocate_policy_t::template address<Id>(storage.data(), chunkFrom));
+        } else {
+            buffers.gathered.resize(numBytes);
+            raw = buffers.gathered.data();
+        }
+        readChunk<Compressor>(is, raw, numBytes, sizeof(T), buffers);
+        if constexpr (!isContiguous<Storage>()) {
+            for (std::size_t i = 0; i < count; ++i) {
+                std::memcpy(allocate_policy_t::template address<Id>(storage.data(), chunkFrom + i),
+                            buffers.gathered.data() + i * sizeof(T), sizeof(T));
+            }
+        }
+    }
+}
+} // namespace detail
+
+/**
+ * Writes the selected Ids of the selected layers of a storage to a stream, e.g.
+ * writeStorage(os, plan, storage, LayerSelection<Interior, Copy>{}, IdSelection<dofs>{});
+ * plan is a LayeredPlan or CombinedLayeredPlan matching the storage.
+ *
+ * The stream holds a header, the selected element ranges with their number of dofs and then, per
+ * range and Id, the values in chunks of at most 1 MiB. The dofs per element are chunked and
+ * compressed like the values. SoA fields are written straight from the
+ * storage, other layouts are gathered chunk-wise. Only trivially copyable types are supported and
+ * the format uses the native byte order.
+ */
+template <typename... SelectedLayers, typename... SelectedIds, typename PlanT, typename Storage,
+          typename Compressor = NoCompression>
+void writeStorage(std::ostream& os, PlanT const& plan, Storage const& storage,
+                  LayerSelection<SelectedLayers...>, IdSelection<SelectedIds...>,
+                  Compressor const& = {}) {
+    static_assert((std::is_trivially_copyable_v<typename SelectedIds::type> && ...),
+                  "Serialization requires trivially copyable types.");
+    const auto& layout = plan.getLayout();
+    if (storage.size() != layout.back()) {
+        throw std::invalid_argument("Storage does not match the layout of the plan.");
+    }
+    const auto ranges = detail::selectedElementRanges<SelectedLayers...>(plan);
+
+    detail::SerializationBuffers buffers;
+    os.write(detail::serializationMagic, sizeof(detail::serializationMagic));
+    detail::writeWord(os, detail::serializationVersion);
+    detail::writeWord(os, detail::idSignature<SelectedIds...>());
+    detail::writeWord(os, Compressor::id);
+    detail::writeWord(os, ranges.size());
+    for (auto const& [from, to] : ranges) {
+        detail::writeWord(os, from);
+        detail::writeWord(os, to);
+        detail::writeCounts<Compressor>(os, layout, from, to, buffers);
+    }
+
+    for (auto const& [from, to] : ranges) {
+        (detail::writeField<SelectedIds, Compressor>(os, storage, layout[from], layout[to],
+                                                     buffers),
+         ...);
+    }
+    if (!os) {
+        throw std::runtime_error("Writing the storage failed.");
+    }
+}
+
+/**
+ * Reads a stream written by writeStorage into an already allocated storage.
+ * Layers, Ids and compressor must match the ones used for writing and the plan must have the same
+ * number of dofs as the written plan in the selected layers; other entries are left untouched.
+ */
+template <typename... SelectedLayers, typename... SelectedIds, typename PlanT, typename Storage,
+          typename Compressor = NoCompression>
+void readStorage(std::istream& is, PlanT const& plan, Storage& storage,
+                 LayerSelection<SelectedLayers...>, IdSelection<SelectedIds...>,
+                 Compressor const& = {}) {
+    static_assert((std::is_trivially_copyable_v<typename SelectedIds::type> && ...),
+                  "Serialization requires trivially copyable types.");
+    const auto& layout = plan.getLayout();
+    if (storage.size() != layout.back()) {
+        throw std::invalid_argument("Storage does not match the layout of the plan.");
+    }
+    const auto ranges = detail::selectedElementRanges<SelectedLayers...>(plan);
+
+    char magic[sizeof(detail::serializationMagic)];
+    if (!is.read(magic, sizeof(magic)) ||
+        !std::equal(magic, magic + sizeof(magic), detail::serializationMagic)) {
+        throw std::runtime_error("Stream does not contain a serialized storage.");
+    }
+    if (detail::readWord(is) != detail::serializationVersion) {
+        throw std::runtime_error("Unsupported serialization version.");
+    }
+    if (detail::readWord(is) != detail::idSignature<SelectedIds...>()) {
+        throw std::runtime_error("Serialized Ids do not match.");
+    }
+    if (detail::readWord(is) != Compressor::id) {
+        throw std::runtime_error("Serialized data uses a different compressor.");
+    }
+    if (detail::readWord(is) != ranges.size()) {
+        throw std::runtime_error("Serialized layers do not match the plan.");
+    }
+    detail::SerializationBuffers buffers;
+    for (auto const& [from, to] : ranges) {
+        if (detail::readWord(is) != from || detail::readWord(is) != to) {
+            throw std::runtime_error("Serialized layers do not match the plan.");
+        }
+        detail::readCounts<Compressor>(is, layout, from, to, buffers);
+    }
+
+    for (auto const& [from, to] : ranges) {
+        (detail::readField<SelectedIds, Compressor>(is, storage, layout[from], layout[to],
+                                                    buffers),
+         ...);
+    }
+}
+
+} // namespace mneme
+
+#endif // MNEME_SERIALIZATION_H_
@@ -0,0 +1,162 @@
+#ifndef MNEME_SIMD_H_
+#define MNEME_SIMD_H_
+
+#include <algorithm>
+#include <cstddef>
+
+#include "storage.hpp"
+#include "view.hpp"
+
+namespace mneme {
+
+/**
+ * Fixed-width pack of W values with lane-wise arithmetic. The operators are plain loops over W
+ * lanes, which compilers turn into vector instructions for arithmetic types.
+ */
+template <typename T, std::size_t W> struct pack {
+    static_assert(W > 0, "Packs need at least one lane.");
+    constexpr static std::size_t width = W;
+
+    T lanes[W];
+
+    static pack broadcast(T value) noexcept {
+        pack result;
+        for (std::size_t k = 0; k < W; ++k) {
+            result.lanes[k] = value;
+        }
+        return result;
+    }
+
+    T& operator[](std::size_t lane) noexcept { return lanes[lane]; }
+    T const& operator[](std::size_t lane) const noexcept { return lanes[lane]; }
+
+#define MNEME_PACK_OPERATOR(OP)                                                                    \
+    pack& operator OP##=(pack const& other) noexcept {                                             \
+        for (std::size_t k = 0; k < W; ++k) {                                                      \
+            lanes[k] OP## = other.lanes[k];                                                        \
+        }                                                                                          \
+        return *this;                                                                              \
+    }                                                                                              \
+    pack& operator OP##=(T const& value) noexcept { return *this OP## = broadcast(value); }      \
+    friend pack operator OP(pack lhs, pack const& rhs) noexcept { return lhs OP## = rhs; }         \
+    friend pack operator OP(pack lhs, T const& rhs) noexcept { return lhs OP## = rhs; }            \
+    friend pack operator OP(T const& lhs, pack const& rhs) noexcept {                             \
+        return broadcast(lhs) OP## = rhs;                                                          \
+    }
+    MNEME_PACK_OPERATOR(+)
+    MNEME_PACK_OPERATOR(-)
+    MNEME_PACK_OPERATOR(*)
+    MNEME_PACK_OPERATOR(/)
+#undef MNEME_PACK_OPERATOR
+
+    pack operator-() const noexcept { return T(0) - *this; }
+};
+
+/**
+ * Proxy for W consecutive elements of a DenseView, starting at element first().
+ * The last batch of a view may be partial; lanes beyond size() are masked, i.e. load() leaves
+ * them value-initialized and store() does not write them.
+ */
+template <typename Storage, std::size_t W> class Batch {
+public:
+    using offset_type = typename Storage::offset_type;
+    using allocate_policy_t = typename Storage::allocate_policy_t;
+
+    Batch(offset_type const& offset, std::size_t first, std::size_t size) noexcept
+        : offset(offset), first_(first), size_(size) {}
+
+    std::size_t first() const noexcept { return first_; }
+    std::size_t size() const noexcept { return size_; }
+    bool isFull() const noexcept { return size_ == W; }
+    bool active(std::size_t lane) const noexcept { return lane < size_; }
+
+    template <typename Id> pack<typename Id::type, W> load() const noexcept {
+        pack<typename Id::type, W> result{};
+        if (isContiguous()) {
+            const auto* values = allocate_policy_t::template address<Id>(offset, first_);
+            if (isFull()) {
+                for (std::size_t k = 0; k < W; ++k) {
+                    result[k] = values[k];
+                }
+            } else {
+                for (std::size_t k = 0; k < size_; ++k) {
+                    result[k] = values[k];
+                }
+            }
+        } else {
+            for (std::size_t k = 0; k < size_; ++k) {
+                result[k] = *allocate_policy_t::template address<Id>(offset, first_ + k);
+            }
+        }
+        return result;
+    }
+
+    template <typename Id> void store(pack<typename Id::type, W> const& values) const noexcept {
+        if (isContiguous()) {
+            auto* target = allocate_policy_t::template address<Id>(offset, first_);
+            if (isFull()) {
+                for (std::size_t k = 0; k < W; ++k) {
+                    target[k] = values[k];
+                }
+            } else {
+                for (std::size_t k = 0; k < size_; ++k) {
+                    target[k] = values[k];
+                }
+            }
+        } else {
+            for (std::size_t k = 0; k < size_; ++k) {
+                *allocate_policy_t::template address<Id>(offset, first_ + k) = values[k];
+            }
+        }
+    }
+
+private:
+    /**
+     * Whether the lanes of every Id are adjacent in memory: always for SoA layouts and for AoSoA
+     * layouts if the batch does not cross a block boundary. AoS layouts are gathered lane by lane.
+     */
+    bool isContiguous() const noexcept {
+        constexpr auto layout = Storage::dataLayout;
+        if constexpr (layout == DataLayout::SoA || layout == DataLayout::SoAArena) {
+            return true;
+        } else if constexpr (isAoSoA(layout)) {
+            constexpr auto blockSize = blockWidth(layout);
+            return (offset.start + first_) % blockSize + size_ <= blockSize;
+        } else {
+            return false;
+        }
+    }
+
+    offset_type offset;
+    std::size_t first_;
+    std::size_t size_;
+};
+
+template <std::size_t W, typename Storage>
+std::size_t numBatches(StridedView<Storage, 1u> const& view) noexcept {
+    return (view.size() + W - 1) / W;
+}
+
+/**
+ * Calls func(batch) for consecutive batches of W elements of a DenseView, e.g.
+ *
+ * forEachBatch<8>(view, [](auto const& batch) {
+ *     const auto rho = batch.template load<density>();
+ *     batch.template store<energy>(rho * batch.template load<velocity>());
+ * });
+ *
+ * With an AoSoA<W> storage whose view starts on a block boundary, every batch is one block.
+ */
+template <std::size_t W, typename Storage, typename Func>
+void forEachBatch(StridedView<Storage, 1u> const& view, Func&& func) {
+    const auto size = view.size();
+    for (std::size_t first = 0; first < size; first += W) {
+        const auto batch =
+            Batch<Storage, W>(view.storageOffset(), first, std::min(W, size - first));
+        func(batch);
+    }
+}
+
+} // namespace mneme
+
+#endif // MNEME_SIMD_H_
@@ -10,10 +10,28 @@ namespace mneme {
 
 inline constexpr std::size_t dynamic_extent = std::numeric_limits<std::size_t>::max();
 
+#if defined(__GNUC__) || defined(__clang__)
+#define MNEME_RESTRICT __restrict__
+#elif defined(_MSC_VER)
+#define MNEME_RESTRICT __restrict
+#else
+#define MNEME_RESTRICT
+#endif
+
+namespace detail {
+template <std::size_t Alignment, typename T> inline T* assumeAligned(T* ptr) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<T*>(__builtin_assume_aligned(ptr, Alignment));
+#else
+    return ptr;
+#endif
+}
+} // namespace detail
+
 template <typename T, std::size_t Extent = dynamic_extent> class span {
 public:
-    using iterator = Iterator<span<T, Extent>>;
-    using const_iterator = Iterator<const span<T, Extent>>;
+    using iterator = T*;
+    using const_iterator = T*;
 
     span(T* base, std::size_t) : base(base) {}
 
@@ -24,11 +42,8 @@ public:
 
     std::size_t size() const { return Extent; }
 
-    iterator begin() { return iterator(this, 0); }
-    iterator end() { return iterator(this, size()); }
-
-    const_iterator begin() const { return const_iterator(this, 0); }
-    const_iterator end() const { return const_iterator(this, size()); }
+    iterator begin() const noexcept { return data(); }
+    iterator end() const noexcept { return data() + size(); }
 
 private:
     T* base = nullptr;
@@ -36,8 +51,8 @@ private:
 
 template <typename T> class span<T, dynamic_extent> {
 public:
-    using iterator = Iterator<span<T, dynamic_extent>>;
-    using const_iterator = Iterator<const span<T, dynamic_extent>>;
+    using iterator = T*;
+    using const_iterator = T*;
 
     span(T* base, std::size_t extent) : base(base), extent(extent) {}
 
@@ -48,6 +63,84 @@ public:
 
     std::size_t size() const { return extent; }
 
+    iterator begin() const noexcept { return data(); }
+    iterator end() const noexcept { return data() + size(); }
+
+private:
+    T* base = nullptr;
+    std::size_t extent;
+};
+
+/**
+ * Span whose first entry is known to be aligned to Alignment bytes. data() tells the compiler so,
+ * which lets loops over the span vectorize without peeling. Bind data() to a restrict_pointer if
+ * the kernel's spans do not alias, e.g.
+ *
+ * typename decltype(q)::restrict_pointer qData = q.data();
+ */
+template <typename T, std::size_t Alignment, std::size_t Extent = dynamic_extent>
+class aligned_span {
+public:
+    static_assert(Alignment > 0 && (Alignment & (Alignment - 1)) == 0,
+                  "Alignment must be a power of two.");
+    static_assert(Alignment >= alignof(T), "Alignment must not be smaller than alignof(T).");
+
+    using iterator = T*;
+    using const_iterator = T*;
+    using restrict_pointer = T* MNEME_RESTRICT;
+    constexpr static std::size_t alignment = Alignment;
+
+    aligned_span(T* base, std::size_t extent) : base(base), extent(extent) {}
+
+    T& operator[](std::size_t idx) const { return data()[idx]; }
+    T* data() const noexcept { return detail::assumeAligned<Alignment>(base); }
+
+    std::size_t size() const {
+        if constexpr (Extent == dynamic_extent) {
+            return extent;
+        } else {
+            return Extent;
+        }
+    }
+
+    operator span<T, Extent>() const { return span<T, Extent>(data(), size()); }
+
+    iterator begin() const noexcept { return data(); }
+    iterator end() const noexcept { return data() + size(); }
+
+private:
+    T* base = nullptr;
+    std::size_t extent = 0;
+};
+
+/**
+ * Span over the entries of one Id inside an array of AoSoA blocks.
+ * Entry pos lives at lane pos % BlockWidth of the Id's array inside block pos / BlockWidth.
+ */
+template <typename T, std::size_t BlockWidth, std::size_t Extent = dynamic_extent>
+class blocked_span {
+public:
+    using iterator = Iterator<blocked_span<T, BlockWidth, Extent>>;
+    using const_iterator = Iterator<const blocked_span<T, BlockWidth, Extent>>;
+
+    blocked_span(T* base, std::size_t blockStride, std::size_t start, std::size_t extent)
+        : base(reinterpret_cast<std::byte*>(base)), blockStride(blockStride), start(start),
+          extent(extent) {}
+
+    T& operator[](std::size_t idx) const {
+        const auto pos = start + idx;
+        auto* block = base + (pos / BlockWidth) * blockStride;
+        return reinterpret_cast<T*>(block)[pos % BlockWidth];
+    }
+
+    std::size_t size() const {
+        if constexpr (Extent == dynamic_extent) {
+            return extent;
+        } else {
+            return Extent;
+        }
+    }
+
     iterator begin() { return iterator(this, 0); }
     iterator end() { return iterator(this, size()); }
 
@@ -55,8 +148,10 @@ public:
     const_iterator end() const { return const_iterator(this, size()); }
 
 private:
-    T* base = nullptr;
-    std::size_t extent;
+    std::byte* base = nullptr;
+    std::size_t blockStride = 0;
+    std::size_t start = 0;
+    std::size_t extent = 0;
 };
 
 } // namespace mneme
@@ -1,12 +1,31 @@
 #ifndef MNEME_STORAGE_H_
 #define MNEME_STORAGE_H_
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory_resource>
+#include <numeric>
+#include <stdexcept>
 #include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "allocators.hpp"
+#include "initialization.hpp"
 #include "iterator.hpp"
+#include "numa.hpp"
+#include "plan.hpp"
+#include "registry.hpp"
 #include "span.hpp"
 #include "tagged_tuple.hpp"
 
@@ -15,45 +34,130 @@ namespace mneme {
 // Storage classes inspired by
 // https://github.com/crosetto/SoAvsAoS
 
-enum class DataLayout { SoA, AoS };
+/**
+ * SoA: One array per Id.
+ * AoS: One array of tagged_tuples.
+ * SoAArena: Like SoA, but all arrays are carved out of a single allocation. Each array starts on
+ * its Id's alignment and the start offsets are staggered so that the arrays do not all map to
+ * the same cache sets.
+ */
+enum class DataLayout : std::size_t { SoA, AoS, SoAArena };
+
+namespace detail {
+constexpr std::size_t AoSoAFlag = std::size_t(1) << (std::numeric_limits<std::size_t>::digits - 1);
+
+template <std::size_t BlockWidth> constexpr DataLayout makeAoSoA() {
+    static_assert(BlockWidth > 0 && BlockWidth < AoSoAFlag, "Invalid AoSoA block width.");
+    return static_cast<DataLayout>(AoSoAFlag | BlockWidth);
+}
+} // namespace detail
+
+/**
+ * Blocked SoA layout: Elements are grouped in blocks of BlockWidth elements and each block stores
+ * every Id as a contiguous array of length BlockWidth.
+ * Use it like MultiStorage<AoSoA<8>, Ids...>; BlockWidth should usually match the SIMD width.
+ */
+template <std::size_t BlockWidth>
+inline constexpr DataLayout AoSoA = detail::makeAoSoA<BlockWidth>();
+
+constexpr bool isAoSoA(DataLayout layout) {
+    return (static_cast<std::size_t>(layout) & detail::AoSoAFlag) != 0;
+}
+
+constexpr std::size_t blockWidth(DataLayout layout) {
+    return isAoSoA(layout) ? static_cast<std::size_t>(layout) & ~detail::AoSoAFlag : 0;
+}
 
 namespace detail {
-template <DataLayout TDataLayout, typename... Ids> struct DataLayoutAllocatePolicy;
+template <std::size_t BlockWidth, typename... Ids> struct AoSoAAllocatePolicy;
+template <std::size_t BlockWidth, std::size_t Extent, typename... Ids> struct AoSoAAccessPolicy;
+
+// Only AoSoA layouts use the primary templates, SoA and AoS are specialized below.
+template <DataLayout TDataLayout, typename... Ids>
+struct DataLayoutAllocatePolicy : AoSoAAllocatePolicy<blockWidth(TDataLayout), Ids...> {
+    static_assert(isAoSoA(TDataLayout), "Unknown data layout.");
+};
 
 template <DataLayout TDataLayout, std::size_t Extent, typename... Ids>
-struct DataLayoutAccessPolicy {
+struct DataLayoutAccessPolicy : AoSoAAccessPolicy<blockWidth(TDataLayout), Extent, Ids...> {
     static constexpr auto layout = TDataLayout;
 };
 
+template <typename Bundle, typename... Ids>
+constexpr auto makeBundleAllocator(std::pmr::memory_resource* resource = nullptr) {
+    if constexpr (AllocatorInfo<Ids...>::template allSameAllocatorAs<AlignedAllocatorBase>()) {
+        constexpr auto alignment = getMaxAlignment<Ids...>();
+        return AlignedAllocator<Bundle, alignment>();
+    } else if constexpr (AllocatorInfo<Ids...>::template allSameAllocatorAs<
+                             HugePageAllocatorBase>()) {
+        return HugePageAllocator<Bundle>();
+    } else if constexpr (AllocatorInfo<Ids...>::template allSameAllocatorAs<
+                             PolymorphicAllocatorBase>()) {
+        constexpr auto alignment = getMaxAlignment<Ids...>();
+        return PolymorphicAllocator<Bundle, alignment>(resource);
+    } else {
+        return AllocatorGetter<Bundle, StandardAllocator<Bundle>>::makeAllocator();
+    }
+}
+
+} // namespace detail
+
+/**
+ * Groups are allocated like AoS bundles of the grouped Ids.
+ */
+template <typename... Ids, typename Default> struct AllocatorGetter<Group<Ids...>, Default> {
+    static_assert(allSameAllocator<Ids...>(), "Grouped Ids must share the same allocator.");
+
+    static auto makeAllocator(std::pmr::memory_resource* resource = nullptr) {
+        return detail::makeBundleAllocator<tagged_tuple<Ids...>, Ids...>(resource);
+    }
+    using type = decltype(makeAllocator());
+};
+
+namespace detail {
 template <typename... Ids> struct DataLayoutAllocatePolicy<DataLayout::AoS, Ids...> {
     using type = tagged_tuple<Ids...>*;
+    // Whether the entries of every Id form an array of their own, see detail::constructHelper.
+    constexpr static bool contiguousIds = false;
 
-    constexpr static auto makeAllocator() {
+    constexpr static auto makeAllocator(std::pmr::memory_resource* resource = nullptr) {
         static_assert(allSameAllocator<Ids...>(),
                       "AoS layout only works if all Ids share the same allocator.");
-        if constexpr (AllocatorInfo<Ids...>::template allSameAllocatorAs<AlignedAllocatorBase>()) {
-            constexpr auto alignment = getMaxAlignment<Ids...>();
-            return AlignedAllocator<tagged_tuple<Ids...>, alignment>();
-        } else {
-            return AllocatorGetter<tagged_tuple<Ids...>,
-                                   StandardAllocator<tagged_tuple<Ids...>>>::makeAllocator();
-        }
+        return makeBundleAllocator<tagged_tuple<Ids...>, Ids...>(resource);
     }
 
-    constexpr static void allocate(type& c, std::size_t size) {
-        auto allocator = makeAllocator();
+    constexpr static void allocate(type& c, std::size_t size,
+                                   std::pmr::memory_resource* resource = nullptr) {
+        auto allocator = makeAllocator(resource);
         c = std::allocator_traits<decltype(allocator)>::allocate(allocator, size);
     }
-    constexpr static void deallocate(type& c, std::size_t size) {
-        auto allocator = makeAllocator();
-        for (std::size_t i = 0; i < size; ++i) {
-            std::allocator_traits<decltype(allocator)>::destroy(allocator, &c[i]);
-        }
+    constexpr static void deallocate(type& c, std::size_t size,
+                                     std::pmr::memory_resource* resource = nullptr) {
+        auto allocator = makeAllocator(resource);
         std::allocator_traits<decltype(allocator)>::deallocate(allocator, c, size);
     }
 
+    constexpr static std::size_t allocatedBytes(std::size_t size,
+                                                std::pmr::memory_resource* resource = nullptr) {
+        return mneme::allocatedBytes<decltype(makeAllocator())>(
+            size * sizeof(tagged_tuple<Ids...>), resource);
+    }
+
     constexpr static type offset(type& c, std::size_t from) { return c + from; }
 
+    template <typename Id>
+    constexpr static typename Id::type* address(type const& c, std::size_t pos) {
+        return &c[pos].template get<Id>();
+    }
+
+    /**
+     * Memory of the bundles whose first entry lies in [from, to) and that end before entry end.
+     */
+    static std::pair<void*, void*> bundleBytes(type const& c, std::size_t from, std::size_t to,
+                                               std::size_t) {
+        return {c + from, c + to};
+    }
+
     constexpr static type null() { return nullptr; }
 };
 
@@ -76,34 +180,49 @@ struct DataLayoutAccessPolicy<DataLayout::AoS, Extent, Ids...> {
     }
 };
 
-template <typename Id> typename Id::type* allocateHelper(std::size_t size) {
-    auto allocator = AllocatorGetter<Id>::makeAllocator();
+template <typename Id>
+typename Id::type* allocateHelper(std::size_t size, std::pmr::memory_resource* resource) {
+    auto allocator = AllocatorGetter<Id>::makeAllocator(resource);
     return std::allocator_traits<decltype(allocator)>::allocate(allocator, size);
 }
 
-template <typename Id> void deallocateHelper(typename Id::type* ptr, std::size_t size) {
-    auto allocator = AllocatorGetter<Id>::makeAllocator();
-    for (std::size_t i = 0; i < size; ++i) {
-        std::allocator_traits<decltype(allocator)>::destroy(allocator, &ptr[i]);
-    }
+template <typename Id>
+void deallocateHelper(typename Id::type* ptr, std::size_t size,
+                      std::pmr::memory_resource* resource) {
+    auto allocator = AllocatorGetter<Id>::makeAllocator(resource);
     std::allocator_traits<decltype(allocator)>::deallocate(allocator, ptr, size);
 }
 
 template <typename... Ids> struct DataLayoutAllocatePolicy<DataLayout::SoA, Ids...> {
     using type = detail::tt_impl<std::add_pointer, Ids...>;
+    constexpr static bool contiguousIds = true;
+
+    constexpr static void allocate(type& c, std::size_t size,
+                                   std::pmr::memory_resource* resource = nullptr) {
+        ((c.template get<Ids>() = allocateHelper<Ids>(size, resource)), ...);
+    }
 
-    constexpr static void allocate(type& c, std::size_t size) {
-        ((c.template get<Ids>() = allocateHelper<Ids>(size)), ...);
+    constexpr static void deallocate(type& c, std::size_t size,
+                                     std::pmr::memory_resource* resource = nullptr) {
+        ((deallocateHelper<Ids>(c.template get<Ids>(), size, resource)), ...);
     }
 
-    constexpr static void deallocate(type& c, std::size_t size) {
-        ((deallocateHelper<Ids>(c.template get<Ids>(), size)), ...);
+    constexpr static std::size_t allocatedBytes(std::size_t size,
+                                                std::pmr::memory_resource* resource = nullptr) {
+        return (mneme::allocatedBytes<typename AllocatorGetter<Ids>::type>(
+                    size * sizeof(typename Ids::type), resource) +
+                ... + 0);
     }
 
     constexpr static type offset(type& c, std::size_t from) {
         return type{(c.template get<Ids>() + from)...};
     }
 
+    template <typename Id>
+    constexpr static typename Id::type* address(type const& c, std::size_t pos) {
+        return c.template get<Id>() + pos;
+    }
+
     constexpr static type null() {
         return type{static_cast<std::add_pointer_t<typename Ids::type>>(nullptr)...};
     }
@@ -129,11 +248,408 @@ struct DataLayoutAccessPolicy<DataLayout::SoA, Extent, Ids...> {
             span<typename Ids::type, Extent>(&c.template get<Ids>()[from], to - from)...};
     }
 };
+
+template <typename... Ids>
+struct DataLayoutAllocatePolicy<DataLayout::SoAArena, Ids...>
+    : DataLayoutAllocatePolicy<DataLayout::SoA, Ids...> {
+    using type = typename DataLayoutAllocatePolicy<DataLayout::SoA, Ids...>::type;
+    using arena_layout_t = std::array<std::size_t, sizeof...(Ids) + 1>;
+
+    constexpr static std::size_t cacheLineSize = 64;
+    // Addresses which differ by a multiple of the aliasing period map to the same L1 cache set
+    // and are subject to 4K aliasing of loads and stores.
+    constexpr static std::size_t aliasingPeriod = 4096;
+
+    template <typename Id> constexpr static std::size_t alignmentOf() {
+        using allocator_t = typename AllocatorGetter<Id>::type;
+        if constexpr (std::is_base_of_v<AlignedAllocatorBase, allocator_t> ||
+                      std::is_base_of_v<HugePageAllocatorBase, allocator_t> ||
+                      std::is_base_of_v<PolymorphicAllocatorBase, allocator_t>) {
+            return std::max(allocator_t::alignment, alignof(typename Id::type));
+        } else {
+            return alignof(typename Id::type);
+        }
+    }
+
+    constexpr static std::size_t arenaAlignment =
+        std::max({cacheLineSize, alignmentOf<Ids>()...});
+
+    constexpr static auto makeAllocator(std::pmr::memory_resource* resource = nullptr) {
+        if constexpr (AllocatorInfo<Ids...>::template allSameAllocatorAs<
+                          HugePageAllocatorBase>()) {
+            return HugePageAllocator<std::byte>();
+        } else if constexpr (AllocatorInfo<Ids...>::template allSameAllocatorAs<
+                                 PolymorphicAllocatorBase>()) {
+            return PolymorphicAllocator<std::byte, arenaAlignment>(resource);
+        } else {
+            return AlignedAllocator<std::byte, arenaAlignment>();
+        }
+    }
+
+    /**
+     * Returns the byte offset of every Id's array followed by the total arena size.
+     * The first array always starts at offset 0.
+     */
+    constexpr static arena_layout_t arenaLayout(std::size_t size) {
+        arena_layout_t offsets{};
+        constexpr std::size_t alignments[] = {alignmentOf<Ids>()...};
+        constexpr std::size_t sizes[] = {sizeof(typename Ids::type)...};
+        std::size_t offset = 0;
+        for (std::size_t i = 0; i < sizeof...(Ids); ++i) {
+            const auto alignment = alignments[i];
+            offset = (offset + alignment - 1) / alignment * alignment;
+            // Alignment and stagger are both powers of two, hence the shift keeps the alignment.
+            const auto stagger = (i * std::max(alignment, cacheLineSize)) % aliasingPeriod;
+            offset += (stagger + aliasingPeriod - offset % aliasingPeriod) % aliasingPeriod;
+            offsets[i] = offset;
+            offset += size * sizes[i];
+        }
+        offsets[sizeof...(Ids)] = offset;
+        return offsets;
+    }
+
+    static void allocate(type& c, std::size_t size,
+                         std::pmr::memory_resource* resource = nullptr) {
+        const auto offsets = arenaLayout(size);
+        auto allocator = makeAllocator(resource);
+        auto* arena = std::allocator_traits<decltype(allocator)>::allocate(
+            allocator, offsets[sizeof...(Ids)]);
+        std::size_t i = 0;
+        ((c.template get<Ids>() = reinterpret_cast<typename Ids::type*>(arena + offsets[i++])),
+         ...);
+    }
+
+    static void deallocate(type& c, std::size_t size,
+                           std::pmr::memory_resource* resource = nullptr) {
+        auto* arena = reinterpret_cast<std::byte*>(std::get<0>(c));
+        auto allocator = makeAllocator(resource);
+        std::allocator_traits<decltype(allocator)>::deallocate(allocator, arena,
+                                                                arenaLayout(size).back());
+    }
+
+    constexpr static std::size_t allocatedBytes(std::size_t size,
+                                                std::pmr::memory_resource* resource = nullptr) {
+        return mneme::allocatedBytes<decltype(makeAllocator())>(arenaLayout(size).back(),
+                                                               resource);
+    }
+};
+
+template <std::size_t Extent, typename... Ids>
+struct DataLayoutAccessPolicy<DataLayout::SoAArena, Extent, Ids...>
+    : DataLayoutAccessPolicy<DataLayout::SoA, Extent, Ids...> {};
+
+/**
+ * Alignment of every element of Stride entries of Id in a SoA array, provided that the first
+ * element starts on the array's alignment: the allocator's alignment capped by the largest power
+ * of two that divides Stride * sizeof(Id::type).
+ */
+template <typename Id, std::size_t Stride> constexpr std::size_t stridedAlignment() {
+    constexpr std::size_t elementBytes = Stride * sizeof(typename Id::type);
+    constexpr std::size_t arrayAlignment =
+        DataLayoutAllocatePolicy<DataLayout::SoAArena, Id>::template alignmentOf<Id>();
+    return std::min(arrayAlignment, elementBytes & (~elementBytes + 1));
+}
+
+/**
+ * Like DataLayoutAccessPolicy for SoA layouts, but elements are aligned_spans that carry the
+ * strided alignment of their Id.
+ */
+template <std::size_t Stride, typename Type> struct AlignedAccessPolicy;
+
+template <std::size_t Stride, typename... Ids>
+struct AlignedAccessPolicy<Stride, tt_impl<std::add_pointer, Ids...>> {
+    using type = tt_impl<std::add_pointer, Ids...>;
+    template <typename Id>
+    using span_t = const aligned_span<typename Id::type, stridedAlignment<Id, Stride>(), Stride>;
+
+    struct value_type : std::tuple<span_t<Ids>...> {
+        using std::tuple<span_t<Ids>...>::tuple;
+
+        template <typename Id> auto const& get() const noexcept {
+            return std::get<index_v<Id, Ids...>>(*this);
+        }
+    };
+
+    static value_type get(type const& c, std::size_t from) noexcept {
+        return value_type{span_t<Ids>(c.template get<Ids>() + from, Stride)...};
+    }
+
+    /**
+     * Returns whether the elements starting at c are aligned as promised by value_type.
+     */
+    static bool isAligned(type const& c) noexcept {
+        return ((reinterpret_cast<std::uintptr_t>(c.template get<Ids>()) %
+                     stridedAlignment<Ids, Stride>() ==
+                 0) &&
+                ...);
+    }
+};
+
+/**
+ * Flattens the per-Id pointers of a SoA offset into an array of untyped pointers, which is
+ * trivially copyable unlike the tuple, see KernelHandle.
+ */
+template <typename Type> struct KernelPointers;
+
+template <typename... Ids> struct KernelPointers<tt_impl<std::add_pointer, Ids...>> {
+    using type = std::array<void*, sizeof...(Ids)>;
+
+    template <typename Id> constexpr static std::size_t index() {
+        return static_cast<std::size_t>(index_v<Id, Ids...>);
+    }
+
+    static type get(tt_impl<std::add_pointer, Ids...> const& c) noexcept {
+        return type{static_cast<void*>(c.template get<Ids>())...};
+    }
+};
+
+template <typename Block> struct BlockPointer {
+    Block* blocks;
+    std::size_t start;
+};
+
+template <std::size_t BlockWidth, typename... Ids> struct AoSoAAllocatePolicy {
+    template <typename T> struct add_block { using type = std::array<T, BlockWidth>; };
+    using block_type = detail::tt_impl<add_block, Ids...>;
+    using type = BlockPointer<block_type>;
+    constexpr static bool contiguousIds = false;
+
+    constexpr static auto makeAllocator(std::pmr::memory_resource* resource = nullptr) {
+        static_assert(allSameAllocator<Ids...>(),
+                      "AoSoA layout only works if all Ids share the same allocator.");
+        return makeBundleAllocator<block_type, Ids...>(resource);
+    }
+
+    constexpr static std::size_t numBlocks(std::size_t size) {
+        return (size + BlockWidth - 1) / BlockWidth;
+    }
+
+    constexpr static std::size_t allocatedBytes(std::size_t size,
+                                                std::pmr::memory_resource* resource = nullptr) {
+        return mneme::allocatedBytes<decltype(makeAllocator())>(
+            numBlocks(size) * sizeof(block_type), resource);
+    }
+
+    constexpr static void allocate(type& c, std::size_t size,
+                                   std::pmr::memory_resource* resource = nullptr) {
+        auto allocator = makeAllocator(resource);
+        c.blocks =
+            std::allocator_traits<decltype(allocator)>::allocate(allocator, numBlocks(size));
+        c.start = 0;
+    }
+    constexpr static void deallocate(type& c, std::size_t size,
+                                     std::pmr::memory_resource* resource = nullptr) {
+        auto allocator = makeAllocator(resource);
+        std::allocator_traits<decltype(allocator)>::deallocate(allocator, c.blocks,
+                                                                numBlocks(size));
+    }
+
+    constexpr static type offset(type& c, std::size_t from) {
+        return type{c.blocks, c.start + from};
+    }
+
+    template <typename Id>
+    constexpr static typename Id::type* address(type const& c, std::size_t pos) {
+        pos += c.start;
+        return &c.blocks[pos / BlockWidth].template get<Id>()[pos % BlockWidth];
+    }
+
+    /**
+     * Memory of the blocks whose first entry lies in [from, to) and that end before entry end.
+     */
+    static std::pair<void*, void*> bundleBytes(type const& c, std::size_t from, std::size_t to,
+                                               std::size_t end) {
+        const auto first = (c.start + from + BlockWidth - 1) / BlockWidth;
+        const auto last = std::min((c.start + to + BlockWidth - 1) / BlockWidth,
+                                   (c.start + end) / BlockWidth);
+        return {c.blocks + first, c.blocks + std::max(first, last)};
+    }
+
+    constexpr static type null() { return type{nullptr, 0}; }
+};
+
+template <std::size_t BlockWidth, typename... Ids>
+struct AoSoAAccessPolicy<BlockWidth, 1u, Ids...> {
+    using type = typename AoSoAAllocatePolicy<BlockWidth, Ids...>::type;
+    using value_type = const detail::tt_impl<std::add_lvalue_reference, Ids...>;
+
+    constexpr static value_type get(type const& c, std::size_t from, std::size_t) {
+        const auto pos = c.start + from;
+        auto& block = c.blocks[pos / BlockWidth];
+        return value_type{block.template get<Ids>()[pos % BlockWidth]...};
+    }
+};
+
+template <std::size_t BlockWidth, std::size_t Extent, typename... Ids> struct AoSoAAccessPolicy {
+    using type = typename AoSoAAllocatePolicy<BlockWidth, Ids...>::type;
+    using block_type = typename AoSoAAllocatePolicy<BlockWidth, Ids...>::block_type;
+    template <typename T> struct add_span {
+        using type = const blocked_span<T, BlockWidth, Extent>;
+    };
+    using value_type = const detail::tt_impl<add_span, Ids...>;
+
+    constexpr static value_type get(type const& c, std::size_t from, std::size_t to) {
+        return value_type{blocked_span<typename Ids::type, BlockWidth, Extent>(
+            c.blocks->template get<Ids>().data(), sizeof(block_type), c.start + from,
+            to - from)...};
+    }
+};
+
+template <typename AllocatePolicy, typename Id>
+void destroyHelper(typename AllocatePolicy::type const& c, std::size_t from, std::size_t to) {
+    using T = typename Id::type;
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+        for (std::size_t i = from; i < to; ++i) {
+            AllocatePolicy::template address<Id>(c, i)->~T();
+        }
+    }
+}
+
+template <typename Id>
+constexpr bool isUninitialized =
+    std::is_same_v<typename InitializationGetter<Id>::type, NoInitialization>;
+
+template <typename AllocatePolicy, typename Id>
+void constructHelper(typename AllocatePolicy::type const& c, std::size_t from, std::size_t to) {
+    using initialization_t = typename InitializationGetter<Id>::type;
+    if constexpr (!isUninitialized<Id>) {
+        std::size_t i = from;
+        try {
+            for (; i < to; ++i) {
+                initialization_t::construct(AllocatePolicy::template address<Id>(c, i), i);
+            }
+        } catch (...) {
+            destroyHelper<AllocatePolicy, Id>(c, from, i);
+            throw;
+        }
+    } else if constexpr (AllocatePolicy::contiguousIds) {
+        // Uninitialized entries are still placed by the constructing thread.
+        if (from < to) {
+            touchPages(AllocatePolicy::template address<Id>(c, from),
+                       AllocatePolicy::template address<Id>(c, to - 1) + 1);
+        }
+    }
+}
+
+template <typename AllocatePolicy, typename Id, typename... Ids>
+void constructIds(typename AllocatePolicy::type const& c, std::size_t from, std::size_t to) {
+    constructHelper<AllocatePolicy, Id>(c, from, to);
+    if constexpr (sizeof...(Ids) > 0) {
+        try {
+            constructIds<AllocatePolicy, Ids...>(c, from, to);
+        } catch (...) {
+            destroyHelper<AllocatePolicy, Id>(c, from, to);
+            throw;
+        }
+    }
+}
+
+/**
+ * Constructs the entries [from, to) according to the Ids' initialization policies. If an
+ * initialization throws, the entries constructed so far are destroyed again.
+ */
+template <typename AllocatePolicy, typename... Ids>
+void construct(typename AllocatePolicy::type const& c, std::size_t from, std::size_t to) {
+    if constexpr (sizeof...(Ids) > 0) {
+        constructIds<AllocatePolicy, Ids...>(c, from, to);
+    }
+}
+
+/**
+ * Places the pages of the AoS or AoSoA bundles whose first entry lies in [from, to) and that
+ * end before entry end, if any Id is left uninitialized. Pages of a bundle are shared by all of
+ * its Ids, hence no entry of the bundles may hold a value yet.
+ */
+template <typename AllocatePolicy, typename... Ids>
+void touchBundles(typename AllocatePolicy::type const& c, std::size_t from, std::size_t to,
+                  std::size_t end) {
+    if constexpr (!AllocatePolicy::contiguousIds && (isUninitialized<Ids> || ...)) {
+        const auto [first, last] = AllocatePolicy::bundleBytes(c, from, to, end);
+        touchPages(first, last);
+    }
+}
+
+/**
+ * Destroys the entries [from, to). Allocate policies only manage memory, hence every constructed
+ * entry has to be destroyed before the memory is deallocated.
+ */
+template <typename AllocatePolicy, typename... Ids>
+void destroy(typename AllocatePolicy::type const& c, std::size_t from, std::size_t to) {
+    (destroyHelper<AllocatePolicy, Ids>(c, from, to), ...);
+}
+
+template <bool DestroySource, typename AllocatePolicy, typename Id>
+void moveConstructHelper(typename AllocatePolicy::type const& dst, std::size_t dstFrom,
+                         typename AllocatePolicy::type const& src, std::size_t srcFrom,
+                         std::size_t count) {
+    using T = typename Id::type;
+    for (std::size_t i = 0; i < count; ++i) {
+        auto* source = AllocatePolicy::template address<Id>(src, srcFrom + i);
+        auto* target = AllocatePolicy::template address<Id>(dst, dstFrom + i);
+        if constexpr (std::is_trivially_copyable_v<T>) {
+            std::memcpy(static_cast<void*>(target), source, sizeof(T));
+        } else {
+            ::new (static_cast<void*>(target)) T(std::move(*source));
+            if constexpr (DestroySource) {
+                source->~T();
+            }
+        }
+    }
+}
+
+/**
+ * Move-constructs count entries of src starting at srcFrom into the uninitialized entries of dst
+ * starting at dstFrom. The source entries stay constructed.
+ */
+template <typename AllocatePolicy, typename... Ids>
+void moveConstruct(typename AllocatePolicy::type const& dst, std::size_t dstFrom,
+                   typename AllocatePolicy::type const& src, std::size_t srcFrom,
+                   std::size_t count) {
+    (moveConstructHelper<false, AllocatePolicy, Ids>(dst, dstFrom, src, srcFrom, count), ...);
+}
+
+/**
+ * Like moveConstruct but destroys the source entries.
+ */
+template <typename AllocatePolicy, typename... Ids>
+void relocate(typename AllocatePolicy::type const& dst, std::size_t dstFrom,
+              typename AllocatePolicy::type const& src, std::size_t srcFrom, std::size_t count) {
+    (moveConstructHelper<true, AllocatePolicy, Ids>(dst, dstFrom, src, srcFrom, count), ...);
+}
+
+template <typename AllocatePolicy, typename Id>
+void moveAssignHelper(typename AllocatePolicy::type const& c, std::size_t dstFrom,
+                      std::size_t srcFrom, std::size_t count) {
+    auto move = [&](std::size_t i) {
+        *AllocatePolicy::template address<Id>(c, dstFrom + i) =
+            std::move(*AllocatePolicy::template address<Id>(c, srcFrom + i));
+    };
+    if (dstFrom < srcFrom) {
+        for (std::size_t i = 0; i < count; ++i) {
+            move(i);
+        }
+    } else {
+        for (std::size_t i = count; i-- > 0;) {
+            move(i);
+        }
+    }
+}
+
+/**
+ * Move-assigns the count constructed entries starting at srcFrom to the constructed entries
+ * starting at dstFrom. The ranges may overlap.
+ */
+template <typename AllocatePolicy, typename... Ids>
+void moveAssign(typename AllocatePolicy::type const& c, std::size_t dstFrom, std::size_t srcFrom,
+                std::size_t count) {
+    (moveAssignHelper<AllocatePolicy, Ids>(c, dstFrom, srcFrom, count), ...);
+}
 } // namespace detail
 
 template <DataLayout TDataLayout, typename... Ids> class MultiStorage {
 public:
     using allocate_policy_t = detail::DataLayoutAllocatePolicy<TDataLayout, Ids...>;
+    constexpr static DataLayout dataLayout = TDataLayout;
     using iterator = Iterator<MultiStorage<TDataLayout, Ids...>>;
     using type = typename allocate_policy_t::type;
     using offset_type = type;
@@ -144,12 +660,105 @@ public:
 
     MultiStorage() {}
 
-    MultiStorage(std::size_t size) : size_(size) { allocate_policy_t::allocate(values, size); }
+    /**
+     * Allocates size entries and constructs them according to the Ids' initialization policies.
+     * Construction is distributed with a static OpenMP schedule over all entries.
+     */
+    MultiStorage(std::size_t size) : MultiStorage(size, NumaDomainMap()) {}
+
+    /**
+     * Like MultiStorage(size) but takes the memory of Ids with a PolymorphicAllocator from
+     * resource, which has to outlive the storage. Other allocators ignore the resource.
+     */
+    MultiStorage(std::size_t size, std::pmr::memory_resource* resource)
+        : MultiStorage(size, NumaDomainMap(), resource) {}
+
+    /**
+     * Like MultiStorage(size) but places the ranges of the domain map on their NUMA nodes before
+     * the entries are constructed.
+     */
+    MultiStorage(std::size_t size, NumaDomainMap const& domains,
+                 std::pmr::memory_resource* resource = nullptr)
+        : size_(size), capacity_(size), resource(resource) {
+        allocate(values, size);
+        placeOrDeallocate(domains);
+        try {
+            constructParallel(0, size);
+        } catch (...) {
+            deallocate(values, capacity_);
+            throw;
+        }
+    }
+
+    /**
+     * Allocates storage for plan.getLayout() and constructs the entries layer by layer.
+     * Each layer is distributed with a static OpenMP schedule over its elements, i.e.
+     * the thread that later processes an element in a statically scheduled loop over the layer
+     * is also the one that touches its memory first.
+     */
+    template <typename PlanT,
+              typename std::enable_if_t<std::is_base_of_v<LayeredPlanBase, PlanT> ||
+                                            std::is_base_of_v<CombinedLayeredPlanBase, PlanT>,
+                                        int> = 0>
+    explicit MultiStorage(PlanT const& plan) : MultiStorage(plan, NumaDomainMap()) {}
 
-    ~MultiStorage() { allocate_policy_t::deallocate(values, size_); }
+    template <typename PlanT,
+              typename std::enable_if_t<std::is_base_of_v<LayeredPlanBase, PlanT> ||
+                                            std::is_base_of_v<CombinedLayeredPlanBase, PlanT>,
+                                        int> = 0>
+    MultiStorage(PlanT const& plan, std::pmr::memory_resource* resource)
+        : MultiStorage(plan, NumaDomainMap(), resource) {}
 
-    MultiStorage(MultiStorage&& other) = default;
-    MultiStorage& operator=(MultiStorage&& other) = default;
+    /**
+     * Like MultiStorage(plan) but places the ranges of the domain map on their NUMA nodes before
+     * the entries are constructed, see also NumaDomainMap::fromClusters.
+     */
+    template <typename PlanT,
+              typename std::enable_if_t<std::is_base_of_v<LayeredPlanBase, PlanT> ||
+                                            std::is_base_of_v<CombinedLayeredPlanBase, PlanT>,
+                                        int> = 0>
+    MultiStorage(PlanT const& plan, NumaDomainMap const& domains,
+                 std::pmr::memory_resource* resource = nullptr)
+        : resource(resource) {
+        const auto& layout = plan.getLayout();
+        size_ = capacity_ = layout.back();
+        allocate(values, size_);
+        placeOrDeallocate(domains);
+        std::vector<std::pair<std::size_t, std::size_t>> constructed;
+        try {
+            plan.forEachLayer([&](Layer const& layer) {
+                const auto last = layer.offset + layer.numElements;
+                constructParallel(layer.offset, last, [&layout](std::size_t elementNo) {
+                    return static_cast<std::size_t>(layout[elementNo]);
+                });
+                constructed.emplace_back(layout[layer.offset], layout[last]);
+            });
+        } catch (...) {
+            for (auto const& [from, to] : constructed) {
+                detail::destroy<allocate_policy_t, Ids...>(values, from, to);
+            }
+            deallocate(values, capacity_);
+            throw;
+        }
+    }
+
+    ~MultiStorage() { release(); }
+
+    MultiStorage(MultiStorage&& other) noexcept
+        : size_(std::exchange(other.size_, 0u)), capacity_(std::exchange(other.capacity_, 0u)),
+          resource(other.resource),
+          values(std::exchange(other.values, allocate_policy_t::null())) {}
+    MultiStorage& operator=(MultiStorage&& other) noexcept {
+        if (this != &other) {
+            release();
+            size_ = std::exchange(other.size_, 0u);
+            capacity_ = std::exchange(other.capacity_, 0u);
+            // The memory belongs to the other storage's resource, hence the resource moves along.
+            resource = other.resource;
+            values = std::exchange(other.values, allocate_policy_t::null());
+        }
+        return *this;
+    }
     MultiStorage(MultiStorage const& other) = delete;
     MultiStorage& operator=(MultiStorage const& other) = delete;
 
@@ -172,27 +781,242 @@ public:
         return access_policy_t<Extent>::get(offset, from, to);
     }
 
+    /**
+     * Changes the number of entries while preserving the first min(size, size()) entries.
+     * New entries are constructed according to the Ids' initialization policies.
+     * Views and offsets are invalidated if the storage has to grow beyond its capacity.
+     */
     void resize(std::size_t size) {
-        allocate_policy_t::deallocate(values, size_);
+        if (size > capacity_) {
+            reallocate(size);
+        }
+        if (size > size_) {
+            constructParallel(size_, size);
+        } else {
+            detail::destroy<allocate_policy_t, Ids...>(values, size, size_);
+        }
         size_ = size;
-        allocate_policy_t::allocate(values, size);
     }
 
+    /**
+     * Makes sure that the storage can hold capacity entries without reallocation.
+     */
+    void reserve(std::size_t capacity) {
+        if (capacity > capacity_) {
+            reallocate(capacity);
+        }
+    }
+
+    void shrink_to_fit() {
+        if (capacity_ > size_) {
+            reallocate(size_);
+        }
+    }
+
+    /**
+     * Inserts count entries before entry pos. Existing entries are moved in a single pass and the
+     * new entries are constructed according to the Ids' initialization policies.
+     */
+    void insert(std::size_t pos, std::size_t count) {
+        if (pos > size_) {
+            throw std::out_of_range("Insert position exceeds storage size.");
+        }
+        const auto newSize = size_ + count;
+        if (newSize > capacity_) {
+            auto newValues = allocate_policy_t::null();
+            const auto newCapacity = std::max(newSize, 2 * capacity_);
+            allocate(newValues, newCapacity);
+            detail::relocate<allocate_policy_t, Ids...>(newValues, 0, values, 0, pos);
+            detail::relocate<allocate_policy_t, Ids...>(newValues, pos + count, values, pos,
+                                                        size_ - pos);
+            deallocate(values, capacity_);
+            values = newValues;
+            capacity_ = newCapacity;
+        } else {
+            // Entries moved into [size_, newSize) need to be constructed, the others assigned.
+            const auto tail = size_ - pos;
+            const auto numConstructed = std::min(count, tail);
+            detail::moveConstruct<allocate_policy_t, Ids...>(
+                values, newSize - numConstructed, values, size_ - numConstructed, numConstructed);
+            detail::moveAssign<allocate_policy_t, Ids...>(values, pos + count, pos,
+                                                          tail - numConstructed);
+            detail::destroy<allocate_policy_t, Ids...>(values, pos, pos + numConstructed);
+        }
+        try {
+            constructParallel(pos, pos + count);
+        } catch (...) {
+            // Close the gap again; the storage keeps its previous entries.
+            detail::relocate<allocate_policy_t, Ids...>(values, pos, values, pos + count,
+                                                        size_ - pos);
+            throw;
+        }
+        size_ = newSize;
+    }
+
+    /**
+     * Removes the entries in the given ranges [from, to) and compacts the storage in a single
+     * pass. The ranges have to be sorted and must not overlap.
+     */
+    void erase(std::vector<std::pair<std::size_t, std::size_t>> const& ranges) {
+        std::size_t write = 0;
+        std::size_t read = 0;
+        for (auto const& [from, to] : ranges) {
+            if (from < read || to < from || to > size_) {
+                throw std::invalid_argument("Erase ranges must be sorted, disjoint and valid.");
+            }
+            detail::moveAssign<allocate_policy_t, Ids...>(values, write, read, from - read);
+            write += from - read;
+            read = to;
+        }
+        detail::moveAssign<allocate_policy_t, Ids...>(values, write, read, size_ - read);
+        write += size_ - read;
+        detail::destroy<allocate_policy_t, Ids...>(values, write, size_);
+        size_ = write;
+    }
+
+    void erase(std::size_t from, std::size_t to) { erase({{from, to}}); }
+
     offset_type offset(std::size_t from) { return allocate_policy_t::offset(values, from); }
 
+    /**
+     * Raw handle to the allocated memory, use allocate_policy_t::address to locate entries.
+     */
+    type const& data() const noexcept { return values; }
+
     inline std::size_t size() const noexcept { return size_; }
+    inline std::size_t capacity() const noexcept { return capacity_; }
+
+    /**
+     * Memory resource of the Ids with a PolymorphicAllocator, nullptr for the default resource.
+     */
+    std::pmr::memory_resource* memoryResource() const noexcept { return resource; }
 
     iterator begin() { return iterator(this, 0); }
     iterator end() { return iterator(this, size()); }
 
 private:
+    void allocate(type& c, std::size_t capacity) {
+        allocate_policy_t::allocate(c, capacity, resource);
+        if (capacity > 0) {
+            MemoryRegistry::add(allocate_policy_t::allocatedBytes(capacity, resource));
+        }
+    }
+
+    void deallocate(type& c, std::size_t capacity) noexcept {
+        allocate_policy_t::deallocate(c, capacity, resource);
+        if (capacity > 0) {
+            MemoryRegistry::remove(allocate_policy_t::allocatedBytes(capacity, resource));
+        }
+    }
+
+    void release() noexcept {
+        detail::destroy<allocate_policy_t, Ids...>(values, 0, size_);
+        deallocate(values, capacity_);
+    }
+
+    void reallocate(std::size_t capacity) {
+        auto newValues = allocate_policy_t::null();
+        allocate(newValues, capacity);
+        detail::relocate<allocate_policy_t, Ids...>(newValues, 0, values, 0, size_);
+        deallocate(values, capacity_);
+        values = newValues;
+        capacity_ = capacity;
+    }
+
+    void placeOrDeallocate(NumaDomainMap const& domains) {
+        try {
+            place(domains);
+        } catch (...) {
+            // Nothing has been constructed yet.
+            deallocate(values, capacity_);
+            throw;
+        }
+    }
+
+    void place(NumaDomainMap const& domains) {
+        for (auto const& range : domains.ranges()) {
+            if (range.to > size_) {
+                throw std::out_of_range("NUMA domain range exceeds storage size.");
+            }
+            if (range.from < range.to) {
+                (placeHelper<Ids>(range, domains.policy()), ...);
+            }
+        }
+    }
+
+    template <typename Id> void placeHelper(NumaDomainMap::Range const& range, NumaPolicy policy) {
+        const auto* first = allocate_policy_t::template address<Id>(values, range.from);
+        const auto* last = allocate_policy_t::template address<Id>(values, range.to - 1) + 1;
+        bindToNumaNode(first, last, range.node, policy);
+    }
+
+    void constructParallel(std::size_t from, std::size_t to) {
+        constructParallel(from, to, [](std::size_t pos) { return pos; });
+    }
+
+    /**
+     * Constructs the entries [entryOf(from), entryOf(to)) of the elements [from, to), where every
+     * OpenMP thread constructs the entries of a contiguous chunk of elements, as a static
+     * schedule would. Bundles that straddle two chunks are placed by the thread owning their
+     * first entry before any thread constructs. If an initialization throws, every entry
+     * constructed here is destroyed again and the exception is rethrown after the parallel
+     * region.
+     */
+    template <typename EntryOf>
+    void constructParallel(std::size_t from, std::size_t to, EntryOf entryOf) {
+#ifdef _OPENMP
+        std::vector<std::pair<std::size_t, std::size_t>> chunks;
+        std::vector<std::exception_ptr> errors;
+#pragma omp parallel
+        {
+            const auto numThreads = static_cast<std::size_t>(omp_get_num_threads());
+            const auto threadId = static_cast<std::size_t>(omp_get_thread_num());
+#pragma omp single
+            {
+                chunks.resize(numThreads);
+                errors.resize(numThreads);
+            }
+            const auto first = entryOf(from + (to - from) * threadId / numThreads);
+            const auto last = entryOf(from + (to - from) * (threadId + 1) / numThreads);
+            chunks[threadId] = {first, last};
+            detail::touchBundles<allocate_policy_t, Ids...>(values, first, last, entryOf(to));
+#pragma omp barrier
+            try {
+                detail::construct<allocate_policy_t, Ids...>(values, first, last);
+            } catch (...) {
+                errors[threadId] = std::current_exception();
+            }
+        }
+        const auto error = std::find_if(errors.begin(), errors.end(),
+                                        [](auto const& e) { return e != nullptr; });
+        if (error != errors.end()) {
+            for (std::size_t t = 0; t < chunks.size(); ++t) {
+                if (!errors[t]) {
+                    detail::destroy<allocate_policy_t, Ids...>(values, chunks[t].first,
+                                                               chunks[t].second);
+                }
+            }
+            std::rethrow_exception(*error);
+        }
+#else
+        detail::construct<allocate_policy_t, Ids...>(values, entryOf(from), entryOf(to));
+#endif
+    }
+
     std::size_t size_ = 0u;
+    std::size_t capacity_ = 0u;
+    std::pmr::memory_resource* resource = nullptr;
     type values = allocate_policy_t::null();
 };
 
-template <typename Id> class SingleStorage : public MultiStorage<DataLayout::SoA, Id> {
+/**
+ * Storage for a single Id whose accessors return the Id's values directly.
+ * @tparam Storage is the underlying SoA storage for Id, e.g. a MultiStorage or MappedStorage.
+ */
+template <typename Id, typename Storage = MultiStorage<DataLayout::SoA, Id>>
+class SingleStorage : public Storage {
 public:
-    using storage_t = MultiStorage<DataLayout::SoA, Id>;
+    using storage_t = Storage;
     using storage_t::storage_t;
     using typename storage_t::offset_type;
     template <std::size_t Extent>
@@ -218,6 +1042,50 @@ public:
     }
 };
 
+/**
+ * Inserts elements with the given number of dofs before element localPos of Layer and inserts
+ * the corresponding entries into the storage, which must match plan.getLayout().
+ */
+template <typename Layer, typename LayeredPlanT, typename Storage>
+void insertElements(LayeredPlanT& plan, Storage& storage, std::size_t localPos,
+                    std::vector<std::size_t> const& dofs) {
+    const auto& layout = plan.getLayout();
+    if (storage.size() != layout.back()) {
+        throw std::invalid_argument("Storage does not match the layout of the plan.");
+    }
+    const auto layer = plan.template getLayer<Layer>();
+    if (localPos > layer.numElements) {
+        throw std::out_of_range("Insert position exceeds layer size.");
+    }
+    const auto elementNo = layer.offset + localPos;
+    storage.insert(layout[elementNo], std::accumulate(dofs.begin(), dofs.end(), std::size_t(0)));
+    plan.template insert<Layer>(localPos, dofs);
+}
+
+/**
+ * Removes the element ranges [from, to) of Layer, relative to the layer, from the plan and
+ * compacts the storage, which must match plan.getLayout(), in a single pass.
+ */
+template <typename Layer, typename LayeredPlanT, typename Storage>
+void eraseElements(LayeredPlanT& plan, Storage& storage,
+                   std::vector<std::pair<std::size_t, std::size_t>> const& localRanges) {
+    const auto& layout = plan.getLayout();
+    if (storage.size() != layout.back()) {
+        throw std::invalid_argument("Storage does not match the layout of the plan.");
+    }
+    const auto layer = plan.template getLayer<Layer>();
+    std::vector<std::pair<std::size_t, std::size_t>> entryRanges;
+    entryRanges.reserve(localRanges.size());
+    for (auto const& [from, to] : localRanges) {
+        if (to > layer.numElements || to < from) {
+            throw std::out_of_range("Erase range exceeds layer size.");
+        }
+        entryRanges.emplace_back(layout[layer.offset + from], layout[layer.offset + to]);
+    }
+    storage.erase(entryRanges);
+    plan.template erase<Layer>(localRanges);
+}
+
 } // namespace mneme
 
 #endif // MNEME_STORAGE_H_
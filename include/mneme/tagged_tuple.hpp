@@ -5,8 +5,28 @@
 #include <tuple>
 #include <type_traits>
 
+#include "initialization.hpp"
+#include "span.hpp"
+
 namespace mneme {
 
+template <typename... Ids> class tagged_tuple;
+
+/**
+ * Bundles Ids that are always accessed together, e.g.
+ * MultiStorage<DataLayout::SoA, Group<rho, mu, lambda>, dofs, bc>.
+ * A group is an Id of its own whose entries are tagged_tuples of the grouped Ids, i.e. a group is
+ * stored as AoS within any layout, while get<rho>() on elements still finds the grouped Id.
+ * On elements of strided views over SoA layouts, get<rho>() returns a strided span over the rho
+ * members of the element's bundles. Strided views over AoSoA layouts only give access to the
+ * whole bundles through get<Group<...>>().
+ * The grouped Ids keep their initialization policies; they should share an allocator.
+ */
+template <typename... Ids> struct Group {
+    using type = tagged_tuple<Ids...>;
+    using initialization = GroupInitialization<Ids...>;
+};
+
 namespace detail {
 template <typename T, typename... Ts> struct index;
 template <typename T, typename... Ts> struct index<T, T, Ts...> : std::integral_constant<int, 0> {};
@@ -16,20 +36,93 @@ template <typename T, typename... Ts> inline constexpr int index_v = index<T, Ts
 
 template <typename T> struct identity { using type = T; };
 
+template <typename Id, typename T> struct contains : std::false_type {};
+template <typename Id, typename... Ids>
+struct contains<Id, Group<Ids...>>
+    : std::disjunction<std::is_same<Id, Ids>..., contains<Id, Ids>...> {};
+
+/**
+ * Index of the group among Ids that contains Id, -1 if there is none.
+ */
+template <typename Id, typename... Ids> constexpr int groupIndex() {
+    constexpr bool matches[] = {contains<Id, Ids>::value..., false};
+    for (std::size_t i = 0; i < sizeof...(Ids); ++i) {
+        if (matches[i]) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+template <typename T> struct is_span : std::false_type {};
+template <typename T, std::size_t Extent> struct is_span<span<T, Extent>> : std::true_type {
+    constexpr static std::size_t extent = Extent;
+};
+
+/**
+ * Returns member Id of a group's entry, which is a bundle or a span of bundles. For spans, the
+ * result is a strided span over the members, i.e. a blocked_span with one bundle per block.
+ */
+template <typename Id, typename Entry> decltype(auto) getGroupMember(Entry&& entry) noexcept {
+    using entry_t = std::remove_cv_t<std::remove_reference_t<Entry>>;
+    if constexpr (is_span<entry_t>::value) {
+        using bundle_t = std::remove_reference_t<decltype(entry[0])>;
+        using member_t = std::remove_reference_t<decltype(entry[0].template get<Id>())>;
+        auto* first = entry.size() > 0 ? &entry[0].template get<Id>() : nullptr;
+        return blocked_span<member_t, 1, is_span<entry_t>::extent>(first, sizeof(bundle_t), 0,
+                                                                   entry.size());
+    } else {
+        return std::forward<Entry>(entry).template get<Id>();
+    }
+}
+
+// Type of member Id of a group's entry: bundles held by value give the member's type, references
+// and spans give what getGroupMember returns.
+template <typename Id, typename Entry,
+          bool = !std::is_reference_v<Entry> && !is_span<std::remove_cv_t<Entry>>::value>
+struct group_member {
+    using type = typename std::remove_cv_t<Entry>::template element_t<Id>;
+};
+template <typename Id, typename Entry> struct group_member<Id, Entry, false> {
+    using type = decltype(getGroupMember<Id>(std::declval<Entry&>()));
+};
+
 template <template <typename> typename type_transform, typename... Ids>
 struct tt_impl : public std::tuple<typename type_transform<typename Ids::type>::type...> {
-    using std::tuple<typename type_transform<typename Ids::type>::type...>::tuple;
-    template <typename Id> auto&& get() noexcept {
-        return std::get<detail::index_v<Id, Ids...>>(*this);
+    using tuple_t = std::tuple<typename type_transform<typename Ids::type>::type...>;
+    using tuple_t::tuple;
+
+    // Ids that are part of a Group are looked up in the group's tuple.
+    template <typename Id> decltype(auto) get() noexcept {
+        if constexpr ((std::is_same_v<Id, Ids> || ...)) {
+            return std::get<detail::index_v<Id, Ids...>>(*this);
+        } else {
+            constexpr auto group = detail::groupIndex<Id, Ids...>();
+            static_assert(group >= 0, "Id is not part of the tuple.");
+            return getGroupMember<Id>(std::get<group>(*this));
+        }
     }
-    template <typename Id> auto&& get() const noexcept {
-        return std::get<detail::index_v<Id, Ids...>>(*this);
+    template <typename Id> decltype(auto) get() const noexcept {
+        if constexpr ((std::is_same_v<Id, Ids> || ...)) {
+            return std::get<detail::index_v<Id, Ids...>>(*this);
+        } else {
+            constexpr auto group = detail::groupIndex<Id, Ids...>();
+            static_assert(group >= 0, "Id is not part of the tuple.");
+            return getGroupMember<Id>(std::get<group>(*this));
+        }
     }
 
-    template <typename Id>
-    using element_t = typename std::tuple_element_t<
-        detail::index_v<Id, Ids...>,
-        std::tuple<typename type_transform<typename Ids::type>::type...>>;
+private:
+    template <typename Id, bool = (std::is_same_v<Id, Ids> || ...)> struct element {
+        using type = std::tuple_element_t<detail::index_v<Id, Ids...>, tuple_t>;
+    };
+    template <typename Id> struct element<Id, false> {
+        using type = typename group_member<
+            Id, std::tuple_element_t<detail::groupIndex<Id, Ids...>(), tuple_t>>::type;
+    };
+
+public:
+    template <typename Id> using element_t = typename element<Id>::type;
 };
 } // namespace detail
 
@@ -1,6 +1,17 @@
 #ifndef MNEME_UTIL_H
 #define MNEME_UTIL_H
 
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <typeinfo>
+
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
+
 namespace mneme {
 struct StaticNothing {};
 
@@ -10,5 +21,47 @@ template <typename T> struct StaticSome {
     T value;
 };
 
+namespace detail {
+inline std::uint64_t fnv1a(std::uint64_t hash, void const* data, std::size_t size) {
+    const auto* bytes = static_cast<unsigned char const*>(data);
+    for (std::size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * Fingerprint of an Id set, built from the Ids' type names and value sizes.
+ * Type names are implementation-defined, hence fingerprints only match between binaries built
+ * with the same compiler.
+ */
+template <typename... Ids> std::uint64_t idSignature() {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    auto add = [&hash](char const* name, std::uint64_t size) {
+        hash = fnv1a(hash, name, std::strlen(name));
+        hash = fnv1a(hash, &size, sizeof(size));
+    };
+    (add(typeid(Ids).name(), sizeof(typename Ids::type)), ...);
+    return hash;
+}
+
+/**
+ * Human readable name of T, demangled where the ABI supports it.
+ */
+template <typename T> std::string typeName() {
+    const char* name = typeid(T).name();
+#ifdef __GNUG__
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    if (status == 0 && demangled != nullptr) {
+        std::string result(demangled);
+        std::free(demangled);
+        return result;
+    }
+#endif
+    return name;
+}
+} // namespace detail
+
 } // namespace mneme
 #endif // MNEME_UTIL_H
@@ -4,21 +4,211 @@
 #include "iterator.hpp"
 #include "plan.hpp"
 #include "span.hpp"
+#include "storage.hpp"
 #include "util.hpp"
 
 #include <cstddef>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <sstream>
 #include <stdexcept>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
 namespace mneme {
 
+/**
+ * Random-access iterator over the elements of a StridedView. It keeps the storage offset of the
+ * current element and bumps it by the stride on increments, instead of recomputing
+ * localId * stride and re-entering the view on every dereference.
+ */
+template <typename Storage, std::size_t Stride> class StridedIterator {
+public:
+    using offset_type = typename Storage::offset_type;
+    using iterator_category = std::random_access_iterator_tag;
+    using reference = typename Storage::template value_type<Stride>;
+    using value_type = std::remove_cv_t<std::remove_reference_t<reference>>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::remove_reference_t<reference>*;
+
+    StridedIterator() = default;
+    StridedIterator(Storage const* container, offset_type const& base, std::size_t stride,
+                    std::size_t position)
+        : container(container), base(base), current(base), stride(stride) {
+        advance(static_cast<difference_type>(position));
+    }
+
+    bool operator==(StridedIterator const& other) const noexcept { return pos == other.pos; }
+    bool operator!=(StridedIterator const& other) const noexcept { return pos != other.pos; }
+    bool operator<(StridedIterator const& other) const noexcept { return pos < other.pos; }
+    bool operator>(StridedIterator const& other) const noexcept { return pos > other.pos; }
+    bool operator<=(StridedIterator const& other) const noexcept { return pos <= other.pos; }
+    bool operator>=(StridedIterator const& other) const noexcept { return pos >= other.pos; }
+
+    StridedIterator& operator++() noexcept {
+        current = Storage::allocate_policy_t::offset(current, stride);
+        ++pos;
+        return *this;
+    }
+    StridedIterator& operator--() noexcept { return advance(-1); }
+    StridedIterator operator++(int) noexcept {
+        StridedIterator copy(*this);
+        ++*this;
+        return copy;
+    }
+    StridedIterator operator--(int) noexcept {
+        StridedIterator copy(*this);
+        advance(-1);
+        return copy;
+    }
+    StridedIterator& operator+=(difference_type n) noexcept { return advance(n); }
+    StridedIterator& operator-=(difference_type n) noexcept { return advance(-n); }
+    StridedIterator operator+(difference_type n) const noexcept {
+        StridedIterator copy(*this);
+        return copy.advance(n);
+    }
+    StridedIterator operator-(difference_type n) const noexcept {
+        StridedIterator copy(*this);
+        return copy.advance(-n);
+    }
+    friend StridedIterator operator+(difference_type n, StridedIterator const& it) noexcept {
+        return it + n;
+    }
+    difference_type operator-(StridedIterator const& other) const noexcept {
+        return pos - other.pos;
+    }
+
+    reference operator*() const noexcept {
+        return container->template get<Stride>(current, 0, getStride());
+    }
+    reference operator[](difference_type n) const noexcept { return *(*this + n); }
+
+private:
+    std::size_t getStride() const noexcept {
+        if constexpr (Stride == dynamic_extent) {
+            return stride;
+        } else {
+            return Stride;
+        }
+    }
+
+    // Offsets only move forward, hence steps back restart from the view's first element.
+    StridedIterator& advance(difference_type n) noexcept {
+        pos += n;
+        if (n >= 0) {
+            current = Storage::allocate_policy_t::offset(current, n * getStride());
+        } else {
+            current = Storage::allocate_policy_t::offset(base, pos * getStride());
+        }
+        return *this;
+    }
+
+    Storage const* container = nullptr;
+    offset_type base{};
+    offset_type current{};
+    std::size_t stride = 0;
+    difference_type pos = 0;
+};
+
+/**
+ * Trivially copyable handle to the elements of a strided view over a SoA storage, which consists
+ * of the base pointer of every Id, the size and the stride only, e.g. for passing by value into
+ * per-thread kernels or device code. Like borrowed views, a handle does not keep the storage
+ * alive and is invalidated when the storage is destroyed or reallocated, e.g. by resize or
+ * reserve beyond its capacity.
+ */
+template <typename Storage, std::size_t Stride = dynamic_extent> class KernelHandle {
+public:
+    static_assert(Storage::dataLayout == DataLayout::SoA ||
+                      Storage::dataLayout == DataLayout::SoAArena,
+                  "Kernel handles require a SoA layout.");
+
+    using pointers_t = detail::KernelPointers<typename Storage::offset_type>;
+
+    KernelHandle() = default;
+    KernelHandle(typename Storage::offset_type const& offset, std::size_t size, std::size_t stride)
+        : base(pointers_t::get(offset)), size_(size), stride_(stride) {}
+
+    template <typename Id> typename Id::type* data() const noexcept {
+        return static_cast<typename Id::type*>(base[pointers_t::template index<Id>()]);
+    }
+
+    template <typename Id> span<typename Id::type, Stride> get(std::size_t localId) const noexcept {
+        return span<typename Id::type, Stride>(data<Id>() + localId * stride(), stride());
+    }
+
+    std::size_t size() const noexcept { return size_; }
+    std::size_t stride() const noexcept {
+        if constexpr (Stride == dynamic_extent) {
+            return stride_;
+        } else {
+            return Stride;
+        }
+    }
+
+private:
+    typename pointers_t::type base{};
+    std::size_t size_ = 0;
+    std::size_t stride_ = 0;
+};
+
+/**
+ * Non-owning counterpart of StridedView, obtained with StridedView::borrow(). It keeps a raw
+ * pointer to the storage instead of a shared_ptr, hence copies do not touch a reference count.
+ *
+ * Lifetime: A borrowed view must not outlive the storage, and it is invalidated like the
+ * storage's offsets, i.e. when the storage is reallocated. Keep the owning view or another
+ * shared_ptr to the storage alive while the borrowed view is in use.
+ */
+template <typename Storage, std::size_t Stride = dynamic_extent> class BorrowedStridedView {
+public:
+    using offset_type = typename Storage::offset_type;
+    using iterator = StridedIterator<Storage, Stride>;
+
+    BorrowedStridedView() = default;
+    BorrowedStridedView(Storage const* container, offset_type const& offset, std::size_t size,
+                        std::size_t stride)
+        : container_(container), offset(offset), size_(size), stride(stride) {}
+
+    auto operator[](std::size_t localId) const noexcept ->
+        typename Storage::template value_type<Stride> {
+        assert(container_ != nullptr);
+        const auto from = localId * getStride();
+        return container_->template get<Stride>(offset, from, from + getStride());
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+    Storage const& storage() const noexcept { return *container_; }
+    offset_type const& storageOffset() const noexcept { return offset; }
+
+    iterator begin() const noexcept { return iterator(container_, offset, stride, 0); }
+    iterator end() const noexcept { return iterator(container_, offset, stride, size()); }
+
+    KernelHandle<Storage, Stride> kernelHandle() const {
+        return KernelHandle<Storage, Stride>(offset, size_, getStride());
+    }
+
+private:
+    std::size_t getStride() const noexcept {
+        if constexpr (Stride == dynamic_extent) {
+            return stride;
+        } else {
+            return Stride;
+        }
+    }
+
+    Storage const* container_ = nullptr;
+    offset_type offset{};
+    std::size_t size_ = 0;
+    std::size_t stride = 0;
+};
+
 template <typename Storage, std::size_t Stride = dynamic_extent> class StridedView {
 public:
     using offset_type = typename Storage::offset_type;
-    using iterator = Iterator<StridedView<Storage, Stride>>;
+    using iterator = StridedIterator<Storage, Stride>;
 
     StridedView() : size_(0), container_(nullptr) {}
 
@@ -36,26 +226,50 @@ public:
         if (!container_) {
             return;
         }
-        offset = container_->offset(layout[from]);
+        firstEntry_ = layout[from];
+        offset = container_->offset(firstEntry_);
         if (!(to > from)) {
             throw std::runtime_error("'To' must be larger than 'from'.");
         }
         if constexpr (Stride == dynamic_extent) {
-            stride = layout[from + 1] - layout[from];
+            stride_ = layout[from + 1] - layout[from];
         } else {
-            stride = Stride;
+            stride_ = Stride;
         }
         for (std::size_t i = from; i < to; ++i) {
             auto stridei = layout[i + 1] - layout[i];
-            if (stridei != stride) {
+            if (stridei != stride_) {
                 std::stringstream ss;
-                ss << "Failed to construct strided view: Stride " << stridei << " != " << stride
+                ss << "Failed to construct strided view: Stride " << stridei << " != " << stride_
                    << " at " << from << ".";
                 throw std::runtime_error(ss.str());
             }
         }
     }
 
+    /**
+     * Views size elements of strd entries each, starting at entry firstEntry, e.g. a layer with
+     * Layer::isUniform(). Unlike setStorage(layout, ...), the layout is not scanned.
+     */
+    void setUniformStorage(std::shared_ptr<Storage> container, std::size_t firstEntry,
+                           std::size_t size, std::size_t strd) {
+        if constexpr (Stride != dynamic_extent) {
+            if (strd != Stride) {
+                std::stringstream ss;
+                ss << "Failed to construct strided view: Stride " << strd << " != " << Stride
+                   << ".";
+                throw std::runtime_error(ss.str());
+            }
+        }
+        size_ = size;
+        stride_ = strd;
+        container_ = std::move(container);
+        if (container_) {
+            firstEntry_ = firstEntry;
+            offset = container_->offset(firstEntry);
+        }
+    }
+
     void setStorage(std::shared_ptr<Storage> container, std::size_t from, std::size_t to,
                     std::size_t strd = 1u) {
         size_ = to - from;
@@ -64,13 +278,14 @@ public:
             return;
         }
         if constexpr (Stride == dynamic_extent) {
-            stride = strd;
+            stride_ = strd;
         } else {
-            stride = Stride;
+            stride_ = Stride;
         }
-        assert(container_->size() % stride == 0);
+        assert(container_->size() % stride_ == 0);
 
-        offset = container_->offset(from * stride);
+        firstEntry_ = from * stride_;
+        offset = container_->offset(firstEntry_);
     }
 
     auto operator[](std::size_t localId) noexcept -> typename Storage::template value_type<Stride> {
@@ -82,7 +297,7 @@ public:
         assert(container_ != nullptr);
         std::size_t s;
         if constexpr (Stride == dynamic_extent) {
-            s = stride;
+            s = stride_;
         } else {
             s = Stride;
         }
@@ -90,24 +305,197 @@ public:
         return container_->template get<Stride>(offset, from, from + s);
     }
 
+    [[nodiscard]] std::size_t size() const noexcept { return size_; }
+    /**
+     * Number of entries of every element.
+     */
+    [[nodiscard]] std::size_t stride() const noexcept {
+        if constexpr (Stride == dynamic_extent) {
+            return stride_;
+        } else {
+            return Stride;
+        }
+    }
+    Storage const& storage() const noexcept { return *container_; }
+    /**
+     * Storage offset of the view's first entry, e.g. for Storage::allocate_policy_t::address.
+     */
+    offset_type const& storageOffset() const noexcept { return offset; }
+    /**
+     * Storage index of the view's first entry.
+     */
+    std::size_t firstEntry() const noexcept { return firstEntry_; }
+
+    iterator begin() const noexcept { return iterator(container_.get(), offset, stride_, 0); }
+    iterator end() const noexcept { return iterator(container_.get(), offset, stride_, size()); }
+
+    /**
+     * Returns a non-owning view of the same elements, see BorrowedStridedView for its lifetime.
+     */
+    BorrowedStridedView<Storage, Stride> borrow() const noexcept {
+        return BorrowedStridedView<Storage, Stride>(container_.get(), offset, size_, stride_);
+    }
+
+    KernelHandle<Storage, Stride> kernelHandle() const { return borrow().kernelHandle(); }
+
+private:
+    std::size_t size_ = 0, stride_ = 0, firstEntry_ = 0;
+    std::shared_ptr<Storage> container_;
+    offset_type offset;
+};
+
+template <typename Storage> using DenseView = StridedView<Storage, 1u>;
+
+/**
+ * Strided view over a SoA storage whose elements are aligned_spans of Stride entries.
+ * The alignment of each Id is derived from its allocator and Stride * sizeof(T), see
+ * detail::stridedAlignment; construction throws if the first element of the range is not aligned
+ * accordingly, e.g. because a preceding layer ends on an odd number of entries.
+ */
+template <typename Storage, std::size_t Stride> class AlignedStridedView {
+public:
+    static_assert(Stride != dynamic_extent, "Aligned views require a static stride.");
+    static_assert(Storage::dataLayout == DataLayout::SoA ||
+                      Storage::dataLayout == DataLayout::SoAArena,
+                  "Aligned views require a SoA layout.");
+
+    using offset_type = typename Storage::offset_type;
+    using access_policy_t = detail::AlignedAccessPolicy<Stride, offset_type>;
+    using value_type = typename access_policy_t::value_type;
+    using iterator = Iterator<AlignedStridedView<Storage, Stride>>;
+
+    AlignedStridedView() : size_(0), container_(nullptr) {}
+
+    template <class Layout>
+    AlignedStridedView(Layout const& layout, std::shared_ptr<Storage> container,
+                       std::size_t from, std::size_t to) {
+        setStorage(layout, std::move(container), from, to);
+    }
+
+    template <class Layout>
+    void setStorage(Layout const& layout, std::shared_ptr<Storage> container, std::size_t from,
+                    std::size_t to) {
+        size_ = to - from;
+        container_ = std::move(container);
+        if (!container_) {
+            return;
+        }
+        if (!(to > from)) {
+            throw std::runtime_error("'To' must be larger than 'from'.");
+        }
+        for (std::size_t i = from; i < to; ++i) {
+            auto stridei = layout[i + 1] - layout[i];
+            if (stridei != Stride) {
+                std::stringstream ss;
+                ss << "Failed to construct aligned view: Stride " << stridei << " != " << Stride
+                   << " at " << i << ".";
+                throw std::runtime_error(ss.str());
+            }
+        }
+        setOffset(layout[from]);
+    }
+
+    /**
+     * See StridedView::setUniformStorage.
+     */
+    void setUniformStorage(std::shared_ptr<Storage> container, std::size_t firstEntry,
+                           std::size_t size, std::size_t stride) {
+        if (stride != Stride) {
+            std::stringstream ss;
+            ss << "Failed to construct aligned view: Stride " << stride << " != " << Stride << ".";
+            throw std::runtime_error(ss.str());
+        }
+        size_ = size;
+        container_ = std::move(container);
+        if (container_) {
+            setOffset(firstEntry);
+        }
+    }
+
+    value_type operator[](std::size_t localId) const noexcept {
+        assert(container_ != nullptr);
+        return access_policy_t::get(offset, localId * Stride);
+    }
+
     [[nodiscard]] std::size_t size() const noexcept { return size_; }
     Storage const& storage() const noexcept { return *container_; }
 
     iterator begin() { return iterator(this, 0); }
     iterator end() { return iterator(this, size()); }
 
+    /**
+     * Returns a non-owning strided view of the same elements, see BorrowedStridedView.
+     */
+    BorrowedStridedView<Storage, Stride> borrow() const noexcept {
+        return BorrowedStridedView<Storage, Stride>(container_.get(), offset, size_, Stride);
+    }
+
+    KernelHandle<Storage, Stride> kernelHandle() const {
+        return KernelHandle<Storage, Stride>(offset, size_, Stride);
+    }
+
 private:
-    std::size_t size_ = 0, stride;
+    void setOffset(std::size_t firstEntry) {
+        offset = container_->offset(firstEntry);
+        if (!access_policy_t::isAligned(offset)) {
+            std::stringstream ss;
+            ss << "Failed to construct aligned view: Entry " << firstEntry << " is not aligned.";
+            throw std::runtime_error(ss.str());
+        }
+    }
+
+    std::size_t size_ = 0;
     std::shared_ptr<Storage> container_;
     offset_type offset;
 };
 
-template <typename Storage> using DenseView = StridedView<Storage, 1u>;
+/**
+ * Non-owning counterpart of GeneralView, obtained with GeneralView::borrow(). Besides the
+ * lifetime contract of BorrowedStridedView, the borrowed view reads the offsets of the general
+ * view, hence the general view (or a copy of it) has to be alive as well.
+ */
+template <typename Storage, typename Offset = std::size_t> class BorrowedGeneralView {
+public:
+    using offset_type = typename Storage::offset_type;
+    using iterator = Iterator<const BorrowedGeneralView<Storage, Offset>>;
+
+    BorrowedGeneralView() = default;
+    BorrowedGeneralView(Storage const* container, offset_type const& offset, Offset const* sl,
+                        std::size_t size)
+        : container_(container), offset(offset), sl(sl), size_(size) {}
+
+    auto operator[](std::size_t localId) const noexcept ->
+        typename Storage::template value_type<dynamic_extent> {
+        assert(container_ != nullptr);
+        return container_->template get<dynamic_extent>(offset, sl[localId], sl[localId + 1]);
+    }
 
-template <typename Storage> class GeneralView {
+    std::size_t size() const noexcept { return size_; }
+    Storage const& storage() const noexcept { return *container_; }
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, size()); }
+
+private:
+    Storage const* container_ = nullptr;
+    offset_type offset{};
+    Offset const* sl = nullptr;
+    std::size_t size_ = 0;
+};
+
+/**
+ * View over elements with varying numbers of entries. The view keeps the entry offsets of its
+ * elements relative to its first entry as Offset, e.g. std::uint32_t halves the memory and
+ * bandwidth of the offsets; construction throws if the view's entries do not fit.
+ * Views created from a shared Displacements<Offset>, e.g. LayeredPlan::getSharedLayout(), read
+ * the offsets from the shared layout instead. Copies of a view share its offsets.
+ */
+template <typename Storage, typename Offset = std::size_t> class GeneralView {
 public:
     using offset_type = typename Storage::offset_type;
-    using iterator = Iterator<GeneralView<Storage>>;
+    using iterator = Iterator<GeneralView<Storage, Offset>>;
+
+    static_assert(std::is_unsigned_v<Offset>, "Offsets must be unsigned.");
 
     GeneralView() : size_(0), container_(nullptr) {}
 
@@ -117,26 +505,53 @@ public:
         setStorage(layout, std::move(container), from, to);
     }
 
+    GeneralView(std::shared_ptr<const Displacements<Offset>> layout,
+                std::shared_ptr<Storage> container, std::size_t from, std::size_t to) {
+        setStorage(std::move(layout), std::move(container), from, to);
+    }
+
+    void setStorage(std::shared_ptr<const Displacements<Offset>> layout,
+                    std::shared_ptr<Storage> container, std::size_t from, std::size_t to) {
+        size_ = to - from;
+        container_ = std::move(container);
+        if (container_ == nullptr) {
+            return;
+        }
+        if (!(to > from)) {
+            throw std::runtime_error("'To' must be larger than 'from'.");
+        }
+        sl = layout->data() + from;
+        offsets_ = std::move(layout);
+        offset = container_->offset(0);
+    }
+
     template <class Layout>
     void setStorage(Layout const& layout, std::shared_ptr<Storage> container, std::size_t from,
                     std::size_t to) {
         size_ = to - from;
-        sl.clear();
-        sl.reserve(size_);
-        sl.insert(sl.begin(), layout.begin() + from, layout.begin() + to);
         container_ = std::move(container);
         if (container_ == nullptr) {
             return;
         }
-        offset = container_->offset(layout[from]);
         if (!(to > from)) {
             throw std::runtime_error("'To' must be larger than 'from'.");
         }
+        const std::size_t first = layout[from];
+        if (layout[to] - first > std::numeric_limits<Offset>::max()) {
+            throw std::runtime_error("Failed to construct general view: Offsets do not fit.");
+        }
+        auto relative = std::make_shared<std::vector<Offset>>(size_ + 1);
+        for (std::size_t i = 0; i <= size_; ++i) {
+            (*relative)[i] = static_cast<Offset>(layout[from + i] - first);
+        }
+        sl = relative->data();
+        offsets_ = std::move(relative);
+        offset = container_->offset(first);
     }
 
     auto operator[](std::size_t localId) noexcept ->
         typename Storage::template value_type<dynamic_extent> {
-        return (*const_cast<const GeneralView<Storage>*>(this))[localId];
+        return (*const_cast<const GeneralView<Storage, Offset>*>(this))[localId];
     }
 
     auto operator[](std::size_t localId) const noexcept ->
@@ -151,61 +566,88 @@ public:
     iterator begin() { return iterator(this, 0); }
     iterator end() { return iterator(this, size()); }
 
+    /**
+     * Returns a non-owning view of the same elements, see BorrowedGeneralView for its lifetime.
+     */
+    BorrowedGeneralView<Storage, Offset> borrow() const noexcept {
+        return BorrowedGeneralView<Storage, Offset>(container_.get(), offset, sl, size_);
+    }
+
 private:
     std::size_t size_ = 0;
-    std::vector<std::size_t> sl;
+    // Entry offsets of the elements, relative to offset, owned by offsets_.
+    Offset const* sl = nullptr;
+    std::shared_ptr<void const> offsets_;
     std::shared_ptr<Storage> container_;
     offset_type offset;
 };
 
 template <typename MaybeStride = StaticNothing, typename MaybePlan = StaticNothing,
-          typename MaybeStorage = StaticNothing, typename MaybeClusterId = StaticNothing>
+          typename MaybeStorage = StaticNothing, typename MaybeClusterId = StaticNothing,
+          typename MaybeLayout = StaticNothing>
 class LayeredViewFactory {
 
 public:
+    constexpr static bool hasStride = !std::is_same_v<MaybeStride, StaticNothing>;
+
     LayeredViewFactory() = default;
 
     LayeredViewFactory(MaybePlan maybePlan, MaybeStorage maybeStorage,
-                       MaybeClusterId maybeClusterId)
-        : maybePlan(maybePlan), maybeStorage(maybeStorage), maybeClusterId(maybeClusterId) {}
+                       MaybeClusterId maybeClusterId, MaybeLayout maybeLayout = {})
+        : maybePlan(maybePlan), maybeStorage(maybeStorage), maybeClusterId(maybeClusterId),
+          maybeLayout(std::move(maybeLayout)) {}
 
     template <std::size_t Stride> [[nodiscard]] auto withStride() const {
         return LayeredViewFactory<std::integral_constant<std::size_t, Stride>, MaybePlan,
-                                  MaybeStorage, MaybeClusterId>(maybePlan, maybeStorage,
-                                                                maybeClusterId);
+                                  MaybeStorage, MaybeClusterId, MaybeLayout>(
+            maybePlan, maybeStorage, maybeClusterId, maybeLayout);
     }
 
     [[nodiscard]] auto withDynamicStride() const { return withStride<dynamic_extent>(); }
 
-    // TODO(Lukas) This shouldn't copy plan probably.
-    template <typename LayeredPlanT> auto withPlan(LayeredPlanT& plan) const {
-        const auto somePlan = StaticSome<LayeredPlanT>(plan);
-        return LayeredViewFactory<MaybeStride, StaticSome<LayeredPlanT>, MaybeStorage,
-                                  MaybeClusterId>(somePlan, maybeStorage, maybeClusterId);
+    /**
+     * Keeps a pointer to plan, hence the plan has to outlive the factory but is not copied.
+     */
+    template <typename LayeredPlanT> auto withPlan(LayeredPlanT const& plan) const {
+        const auto somePlan = StaticSome<LayeredPlanT const*>(&plan);
+        return LayeredViewFactory<MaybeStride, StaticSome<LayeredPlanT const*>, MaybeStorage,
+                                  MaybeClusterId, MaybeLayout>(somePlan, maybeStorage,
+                                                               maybeClusterId, maybeLayout);
     }
+    /**
+     * Temporary plans would dangle, see withPlan(LayeredPlanT const&).
+     */
+    template <typename LayeredPlanT> auto withPlan(LayeredPlanT const&& plan) const = delete;
 
     template <typename StorageT> constexpr auto withStorage(StorageT storage) const {
         auto someStorage = StaticSome<StorageT>(storage);
-        return LayeredViewFactory<MaybeStride, MaybePlan, StaticSome<StorageT>, MaybeClusterId>(
-            maybePlan, std::move(someStorage), maybeClusterId);
+        return LayeredViewFactory<MaybeStride, MaybePlan, StaticSome<StorageT>, MaybeClusterId,
+                                  MaybeLayout>(maybePlan, std::move(someStorage),
+                                               maybeClusterId, maybeLayout);
     }
     [[nodiscard]] auto withClusterId(std::size_t clusterId) const {
         const auto someClusterId = StaticSome<std::size_t>(clusterId);
-        return LayeredViewFactory<MaybeStride, MaybePlan, MaybeStorage, StaticSome<std::size_t>>(
-            maybePlan, maybeStorage, someClusterId);
+        return LayeredViewFactory<MaybeStride, MaybePlan, MaybeStorage, StaticSome<std::size_t>,
+                                  MaybeLayout>(maybePlan, maybeStorage, someClusterId,
+                                               maybeLayout);
+    }
+
+    /**
+     * Uses layout instead of plan.getLayout() for the views, e.g. plan.getRunLengthLayout() or
+     * plan.getCompactLayout(). The layout has to match the plan; copies of the factory share it.
+     */
+    template <typename LayoutT> [[nodiscard]] auto withLayout(LayoutT layout) const {
+        using some_layout_t = StaticSome<std::shared_ptr<const LayoutT>>;
+        return LayeredViewFactory<MaybeStride, MaybePlan, MaybeStorage, MaybeClusterId,
+                                  some_layout_t>(
+            maybePlan, maybeStorage, maybeClusterId,
+            some_layout_t(std::make_shared<const LayoutT>(std::move(layout))));
     }
 
     template <typename Layer, typename MaybePlan_ = MaybePlan>
     [[nodiscard]] std::pair<std::size_t, std::size_t> getFromToForLayer() const {
-        if constexpr (std::is_base_of_v<CombinedLayeredPlanBase, typename MaybePlan_::type>) {
-            static_assert(!std::is_same_v<MaybeClusterId, StaticNothing>,
-                          "Cluster id has to be set when using CombinedLayer.");
-            const auto& layer = maybePlan.value.template getLayer<Layer>(maybeClusterId.value);
-            return {layer.offset, layer.offset + layer.numElements};
-        } else {
-            const auto& layer = maybePlan.value.template getLayer<Layer>();
-            return {layer.offset, layer.offset + layer.numElements};
-        }
+        const auto layer = getPlanLayer<Layer, MaybePlan_>();
+        return {layer.offset, layer.offset + layer.numElements};
     }
 
     template <
@@ -216,11 +658,22 @@ public:
         typename std::enable_if<!std::is_same<MaybeStorage_, StaticNothing>::value, int>::type = 0,
         typename std::enable_if<std::is_same<MaybeClusterId_, StaticNothing>::value, int>::type = 0>
     [[nodiscard]] auto createStridedView() const {
-        auto layout = maybePlan.value.getLayout();
-        const auto [from, to] = getFromToForLayer<Layer>();
+        StridedView<typename MaybeStorage_::type::element_type, MaybeStride::value> view;
+        setViewStorage(view, getPlanLayer<Layer>(), maybeStorage.value);
+        return view;
+    }
 
-        return StridedView<typename MaybeStorage_::type::element_type, MaybeStride::value>(
-            layout, (maybeStorage.value), from, to);
+    template <
+        typename Layer, typename MaybeStride_ = MaybeStride, typename MaybePlan_ = MaybePlan,
+        typename MaybeStorage_ = MaybeStorage, typename MaybeClusterId_ = MaybeClusterId,
+        typename std::enable_if<!std::is_same<MaybeStride_, StaticNothing>::value, int>::type = 0,
+        typename std::enable_if<!std::is_same<MaybePlan_, StaticNothing>::value, int>::type = 0,
+        typename std::enable_if<!std::is_same<MaybeStorage_, StaticNothing>::value, int>::type = 0,
+        typename std::enable_if<std::is_same<MaybeClusterId_, StaticNothing>::value, int>::type = 0>
+    [[nodiscard]] auto createAlignedStridedView() const {
+        AlignedStridedView<typename MaybeStorage_::type::element_type, MaybeStride::value> view;
+        setViewStorage(view, getPlanLayer<Layer>(), maybeStorage.value);
+        return view;
     }
 
     template <
@@ -230,17 +683,68 @@ public:
         typename std::enable_if<!std::is_same<MaybePlan_, StaticNothing>::value, int>::type = 0,
         typename std::enable_if<!std::is_same<MaybeStorage_, StaticNothing>::value, int>::type = 0>
     constexpr auto createDenseView() {
-        auto layout = maybePlan.value.getLayout();
-        const auto [from, to] = getFromToForLayer<Layer>();
+        DenseView<typename MaybeStorage_::type::element_type> view;
+        setViewStorage(view, getPlanLayer<Layer>(), std::move(maybeStorage.value));
+        return view;
+    }
 
-        return DenseView<typename MaybeStorage_::type::element_type>(
-            layout, std::move(maybeStorage.value), from, to);
+    /**
+     * Creates a GeneralView that reads its offsets from the plan's shared layout, i.e. the
+     * offsets are not copied.
+     */
+    template <
+        typename Layer, typename MaybeStride_ = MaybeStride, typename MaybePlan_ = MaybePlan,
+        typename MaybeStorage_ = MaybeStorage,
+        typename std::enable_if<std::is_same<MaybeStride_, StaticNothing>::value, int>::type = 0,
+        typename std::enable_if<!std::is_same<MaybePlan_, StaticNothing>::value, int>::type = 0,
+        typename std::enable_if<!std::is_same<MaybeStorage_, StaticNothing>::value, int>::type = 0>
+    [[nodiscard]] auto createGeneralView() const {
+        const auto [from, to] = getFromToForLayer<Layer>();
+        using view_t = GeneralView<typename MaybeStorage_::type::element_type>;
+        if constexpr (std::is_same_v<MaybeLayout, StaticNothing>) {
+            return view_t(maybePlan.value->getSharedLayout(), maybeStorage.value, from, to);
+        } else {
+            return view_t(*maybeLayout.value, maybeStorage.value, from, to);
+        }
     }
 
 private:
+    template <typename Layer, typename MaybePlan_ = MaybePlan> Layer getPlanLayer() const {
+        using plan_t = std::remove_const_t<std::remove_pointer_t<typename MaybePlan_::type>>;
+        if constexpr (std::is_base_of_v<CombinedLayeredPlanBase, plan_t>) {
+            static_assert(!std::is_same_v<MaybeClusterId, StaticNothing>,
+                          "Cluster id has to be set when using CombinedLayer.");
+            return maybePlan.value->template getLayer<Layer>(maybeClusterId.value);
+        } else {
+            return maybePlan.value->template getLayer<Layer>();
+        }
+    }
+
+    decltype(auto) getLayout() const {
+        if constexpr (std::is_same_v<MaybeLayout, StaticNothing>) {
+            return maybePlan.value->getLayout();
+        } else {
+            return (*maybeLayout.value);
+        }
+    }
+
+    // Uniform layers only need the layout's first entry, hence their views are created in O(1).
+    template <typename View, typename LayerT, typename StoragePtr>
+    void setViewStorage(View& view, LayerT const& layer, StoragePtr storage) const {
+        const auto& layout = getLayout();
+        if (layer.isUniform()) {
+            view.setUniformStorage(std::move(storage), layout[layer.offset], layer.numElements,
+                                   layer.stride);
+        } else {
+            view.setStorage(layout, std::move(storage), layer.offset,
+                            layer.offset + layer.numElements);
+        }
+    }
+
     MaybePlan maybePlan;
     MaybeStorage maybeStorage;
     MaybeClusterId maybeClusterId;
+    MaybeLayout maybeLayout;
 };
 
 constexpr auto createViewFactory() {
@@ -98,6 +98,56 @@ TEST_CASE("Alignment works MultiStorage") {
     }
 }
 
+struct dofsHugePage {
+    using type = double;
+    using allocator = HugePageAllocator<type>;
+};
+
+struct materialHugePage {
+    using type = int;
+    using allocator = HugePageAllocator<type>;
+};
+
+TEST_CASE("Huge page allocator works") {
+    using allocator_t = HugePageAllocator<double>;
+    using allocator_traits_t = std::allocator_traits<allocator_t>;
+    auto allocator = allocator_t();
+    constexpr std::size_t numElements = 3 * allocator_t::hugePageSize / sizeof(double) + 1;
+    auto* mem = allocator_traits_t::allocate(allocator, numElements);
+    checkPointerAlignment(mem, allocator_t::hugePageSize);
+    mem[0] = 1.0;
+    mem[numElements - 1] = 2.0;
+    CHECK(mem[0] + mem[numElements - 1] == 3.0);
+    allocator_traits_t::deallocate(allocator, mem, numElements);
+
+    CHECK(allSameAllocator<dofsHugePage, materialHugePage>());
+    CHECK(!allSameAllocator<dofsHugePage, dofsAligned>());
+    CHECK(getMaxAlignment<dofsHugePage, materialHugePage>() == allocator_t::hugePageSize);
+
+    SUBCASE("Huge page allocator can be used with std containers") {
+        auto vec = std::vector<int, HugePageAllocator<int>>(1000, 1);
+        checkPointerAlignment(vec.data(), allocator_t::hugePageSize);
+        vec.resize(2000000, 2);
+        CHECK(vec.front() == 1);
+        CHECK(vec.back() == 2);
+    }
+
+    SUBCASE("Huge page allocator works with MultiStorage") {
+        constexpr std::size_t size = 1000;
+        auto storageAoS = MultiStorage<DataLayout::AoS, dofsHugePage, materialHugePage>(size);
+        auto storageSoA = MultiStorage<DataLayout::SoA, dofsHugePage, materialHugePage>(size);
+        checkPointerAlignment(&storageAoS[0], allocator_t::hugePageSize);
+        checkPointerAlignment(&storageSoA[0].get<dofsHugePage>(), allocator_t::hugePageSize);
+        checkPointerAlignment(&storageSoA[0].get<materialHugePage>(), allocator_t::hugePageSize);
+        for (std::size_t i = 0; i < size; ++i) {
+            storageSoA[i].get<materialHugePage>() = i;
+            storageAoS[i].get<materialHugePage>() = i;
+        }
+        CHECK(storageSoA[size - 1].get<materialHugePage>() == size - 1);
+        CHECK(storageAoS[size - 1].get<materialHugePage>() == size - 1);
+    }
+}
+
 struct A {
     using type = double;
     using allocator = AlignedAllocator<type, alignment>;
@@ -125,3 +175,176 @@ TEST_CASE("Default allocator compiles") {
     auto testSoA = MultiStorage<DataLayout::SoA, IdWithoutAllocator>(5);
     auto testSingle = SingleStorage<IdWithoutAllocator>(5);
 }
+
+struct small {
+    using type = float;
+};
+struct large {
+    using type = double;
+    using allocator = AlignedAllocator<type, 128>;
+};
+
+TEST_CASE("Single arena SoA") {
+    constexpr std::size_t numElements = 1024;
+    using storage_t = MultiStorage<DataLayout::SoAArena, dofsUnaligned, small, large, B>;
+    auto storage = storage_t(numElements);
+
+    auto address = [&](auto* ptr) { return reinterpret_cast<uintptr_t>(ptr); };
+    const auto first = address(&storage[0].get<dofsUnaligned>());
+    const std::vector<uintptr_t> starts = {first, address(&storage[0].get<small>()),
+                                           address(&storage[0].get<large>()),
+                                           address(&storage[0].get<B>())};
+    const std::vector<std::size_t> sizes = {sizeof(double), sizeof(float), sizeof(double),
+                                            sizeof(int)};
+    checkPointerAlignment(&storage[0].get<large>(), 128);
+    for (std::size_t i = 0; i < starts.size(); ++i) {
+        checkPointerAlignment(reinterpret_cast<void*>(starts[i]), 64);
+        // All fields live in one arena, in order and without overlap.
+        if (i > 0) {
+            CHECK(starts[i] >= starts[i - 1] + numElements * sizes[i - 1]);
+        }
+        CHECK(starts[i] - first < 2 * numElements * sizeof(double) * starts.size());
+        // Fields do not alias each other modulo the page size.
+        for (std::size_t j = 0; j < i; ++j) {
+            CHECK(starts[i] % 4096 != starts[j] % 4096);
+        }
+    }
+
+    for (std::size_t i = 0; i < numElements; ++i) {
+        storage[i].get<B>() = i;
+        storage[i].get<large>() = 2.0 * i;
+    }
+    for (std::size_t i = 0; i < numElements; ++i) {
+        CHECK(storage[i].get<B>() == i);
+        CHECK(storage[i].get<large>() == 2.0 * i);
+    }
+}
+
+struct dofsPooled {
+    using type = double;
+    using allocator = PolymorphicAllocator<type, 64>;
+};
+
+struct materialPooled {
+    using type = int;
+    using allocator = PolymorphicAllocator<type>;
+};
+
+struct PooledLayer : public Layer {};
+
+TEST_CASE("Pooled memory resource") {
+    CHECK(PooledMemoryResource::blockSizeOf(1) == 4096);
+    CHECK(PooledMemoryResource::blockSizeOf(8192) == 8192);
+    CHECK(PooledMemoryResource::blockSizeOf(8193) == 10240);
+    CHECK(PooledMemoryResource::blockSizeOf(100000) == 114688);
+
+    auto resource = PooledMemoryResource();
+    SUBCASE("Storages recycle blocks") {
+        using storage_t = MultiStorage<DataLayout::SoA, dofsPooled, materialPooled>;
+        const dofsPooled::type* first = nullptr;
+        {
+            auto storage = storage_t(10000, &resource);
+            CHECK(storage.memoryResource() == &resource);
+            first = &storage[0].get<dofsPooled>();
+            checkPointerAlignment(first, 64);
+        }
+        CHECK(resource.cachedBytes() > 0);
+        auto storage = storage_t(9000, &resource);
+        CHECK(&storage[0].get<dofsPooled>() == first);
+        CHECK(resource.cachedBytes() == 0);
+
+        storage.resize(20000);
+        auto moved = std::move(storage);
+        CHECK(moved.memoryResource() == &resource);
+        CHECK(resource.cachedBytes() > 0);
+    }
+
+    SUBCASE("Bundled layouts use the resource") {
+        const auto plan = LayeredPlan().withDofs<PooledLayer>(100, [](auto) { return 3U; });
+        {
+            auto aos = MultiStorage<DataLayout::AoS, dofsPooled, materialPooled>(plan, &resource);
+            auto arena =
+                MultiStorage<DataLayout::SoAArena, dofsPooled, materialPooled>(300, &resource);
+            auto aosoa = MultiStorage<AoSoA<8>, dofsPooled, materialPooled>(300, &resource);
+            aos[299].get<materialPooled>() = 1;
+            arena[299].get<materialPooled>() = 1;
+            aosoa[299].get<materialPooled>() = 1;
+            CHECK(resource.cachedBytes() == 0);
+        }
+        CHECK(resource.cachedBytes() > 0);
+        resource.release();
+        CHECK(resource.cachedBytes() == 0);
+    }
+
+    SUBCASE("Default resource") {
+        auto storage = MultiStorage<DataLayout::SoA, dofsPooled>(100);
+        CHECK(storage.memoryResource() == nullptr);
+        storage[99].get<dofsPooled>() = 1.0;
+        CHECK(resource.cachedBytes() == 0);
+    }
+}
+
+struct dofsVector {
+    using type = double;
+    using allocator = AlignedAllocator<type, 64>;
+};
+
+struct materialVector {
+    using type = float;
+    using allocator = AlignedAllocator<type, 64>;
+};
+
+struct VectorLayer : public Layer {};
+struct OddLayer : public Layer {};
+
+TEST_CASE("Aligned strided views") {
+    CHECK(detail::stridedAlignment<dofsVector, 8>() == 64);
+    CHECK(detail::stridedAlignment<dofsVector, 4>() == 32);
+    CHECK(detail::stridedAlignment<dofsVector, 3>() == 8);
+    CHECK(detail::stridedAlignment<materialVector, 8>() == 32);
+    CHECK(detail::stridedAlignment<dofsUnaligned, 8>() == alignof(double));
+
+    constexpr std::size_t numElements = 10;
+    constexpr std::size_t numDofs = 8;
+    using storage_t = MultiStorage<DataLayout::SoA, dofsVector, materialVector>;
+    using view_t = AlignedStridedView<storage_t, numDofs>;
+    const auto plan =
+        LayeredPlan().withDofs<VectorLayer>(numElements, [](auto) { return numDofs; });
+    auto storage = std::make_shared<storage_t>(plan.getLayout().back());
+    auto view = createViewFactory()
+                    .withPlan(plan)
+                    .withStorage(storage)
+                    .withStride<numDofs>()
+                    .createAlignedStridedView<VectorLayer>();
+    CHECK(std::is_same_v<decltype(view), view_t>);
+    CHECK(view.size() == numElements);
+
+    std::size_t i = 0;
+    for (auto element : view) {
+        auto& dofs = element.get<dofsVector>();
+        using dofs_span_t = std::decay_t<decltype(dofs)>;
+        CHECK(dofs_span_t::alignment == 64);
+        CHECK(dofs.size() == numDofs);
+        checkPointerAlignment(dofs.data(), 64);
+        checkPointerAlignment(element.get<materialVector>().data(), 32);
+        dofs_span_t::restrict_pointer dofsData = dofs.data();
+        for (std::size_t j = 0; j < numDofs; ++j) {
+            dofsData[j] = i * numDofs + j;
+        }
+        ++i;
+    }
+    for (std::size_t j = 0; j < numElements * numDofs; ++j) {
+        CHECK((*storage)[j].get<dofsVector>() == j);
+    }
+
+    const auto oddPlan = LayeredPlan()
+                             .withDofs<OddLayer>(1, [](auto) { return 3U; })
+                             .withDofs<VectorLayer>(numElements, [](auto) { return numDofs; });
+    auto oddStorage = std::make_shared<storage_t>(oddPlan.getLayout().back());
+    const auto oddFactory =
+        createViewFactory().withPlan(oddPlan).withStorage(oddStorage).withStride<numDofs>();
+    CHECK_THROWS_AS(static_cast<void>(oddFactory.createAlignedStridedView<VectorLayer>()),
+                    std::runtime_error);
+    CHECK_THROWS_AS(static_cast<void>(oddFactory.createAlignedStridedView<OddLayer>()),
+                    std::runtime_error);
+}
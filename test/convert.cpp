@@ -0,0 +1,124 @@
+#include "doctest.h"
+#include "mneme/convert.hpp"
+#include "mneme/plan.hpp"
+#include "mneme/storage.hpp"
+
+#include <array>
+#include <memory>
+#include <string>
+
+using namespace mneme;
+
+namespace {
+struct rho {
+    using type = double;
+};
+struct velocity {
+    using type = std::array<float, 3>;
+};
+struct tag {
+    using type = char;
+};
+struct name {
+    using type = std::string;
+};
+
+struct Interior : public Layer {};
+struct Copy : public Layer {};
+struct Ghost : public Layer {};
+
+template <typename Storage> void fill(Storage& storage) {
+    for (std::size_t i = 0; i < storage.size(); ++i) {
+        storage[i].template get<rho>() = 1.5 * i;
+        storage[i].template get<velocity>() = {1.0F * i, 2.0F * i, 3.0F * i};
+        storage[i].template get<tag>() = static_cast<char>(i % 128);
+    }
+}
+
+template <typename Storage>
+void check(Storage const& storage, std::size_t from, std::size_t to, bool expectFilled) {
+    for (std::size_t i = from; i < to; ++i) {
+        if (expectFilled) {
+            CHECK(storage[i].template get<rho>() == 1.5 * i);
+            CHECK(storage[i].template get<velocity>()[2] == 3.0F * i);
+            CHECK(storage[i].template get<tag>() == static_cast<char>(i % 128));
+        } else {
+            CHECK(storage[i].template get<rho>() == 0.0);
+        }
+    }
+}
+} // namespace
+
+TEST_CASE("Layout conversion") {
+    constexpr std::size_t size = 1000;
+    using ids_aos_t = MultiStorage<DataLayout::AoS, rho, velocity, tag>;
+    using ids_soa_t = MultiStorage<DataLayout::SoA, rho, velocity, tag>;
+    using ids_aosoa_t = MultiStorage<AoSoA<8>, rho, velocity, tag>;
+
+    SUBCASE("AoS to SoA and back") {
+        ids_aos_t aos(size);
+        ids_soa_t soa(size);
+        ids_aos_t aos2(size);
+        fill(aos);
+        convertLayout(soa, aos);
+        check(soa, 0, size, true);
+        convertLayout(aos2, soa);
+        check(aos2, 0, size, true);
+    }
+
+    SUBCASE("AoSoA to SoA and back") {
+        ids_aosoa_t aosoa(size);
+        ids_soa_t soa(size);
+        ids_aosoa_t aosoa2(size);
+        fill(aosoa);
+        convertLayout(soa, aosoa);
+        check(soa, 0, size, true);
+        convertLayout(aosoa2, soa);
+        check(aosoa2, 0, size, true);
+    }
+
+    SUBCASE("AoSoA ranges across blocks") {
+        ids_aosoa_t aosoa(size);
+        MultiStorage<AoSoA<4>, rho, velocity, tag> aosoa4(size);
+        ids_aos_t aos(size);
+        for (std::size_t i = 0; i < aos.size(); ++i) {
+            aos[i].get<rho>() = 0.0;
+        }
+        fill(aosoa);
+        convertLayout(aosoa4, aosoa, 5, size - 3);
+        convertLayout(aos, aosoa4, 5, size - 3);
+        check(aos, 0, 5, false);
+        check(aos, 5, size - 3, true);
+        check(aos, size - 3, size, false);
+    }
+
+    SUBCASE("Non-trivial types") {
+        MultiStorage<DataLayout::AoS, name, rho> aos(3);
+        MultiStorage<DataLayout::SoA, name, rho> soa(3);
+        aos[1].get<name>() = "mneme";
+        convertLayout(soa, aos);
+        CHECK(soa[1].get<name>() == "mneme");
+        CHECK(soa[2].get<name>().empty());
+    }
+
+    SUBCASE("Selected layers") {
+        const auto plan = LayeredPlan()
+                              .withDofs<Interior>(300, [](auto) { return 2U; })
+                              .withDofs<Copy>(100, [](auto) { return 1U; })
+                              .withDofs<Ghost>(50, [](auto) { return 1U; });
+        const auto& layout = plan.getLayout();
+        ids_aos_t aos(plan);
+        MultiStorage<DataLayout::SoAArena, rho, velocity, tag> soa(plan);
+        for (std::size_t i = 0; i < soa.size(); ++i) {
+            soa[i].get<rho>() = 0.0;
+        }
+        fill(aos);
+        convertLayers<Interior, Copy>(soa, aos, plan);
+        const auto ghost = plan.getLayer<Ghost>();
+        check(soa, 0, layout[ghost.offset], true);
+        check(soa, layout[ghost.offset], soa.size(), false);
+    }
+
+    CHECK_THROWS_AS(convertLayout(*std::make_unique<ids_soa_t>(2), ids_aos_t(3)),
+                    std::invalid_argument);
+}
@@ -1,10 +1,20 @@
 #include "doctest.h"
+#include <algorithm>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <sstream>
 #include <utility>
 #include <vector>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "mneme/displacements.hpp"
 
+using mneme::CompactDisplacements;
 using mneme::Displacements;
 
 TEST_CASE("testing displacements") {
@@ -51,3 +61,124 @@ TEST_CASE("testing displacements") {
         }
     }
 }
+
+TEST_CASE("Displacements from generators and iterators") {
+    constexpr std::size_t n = 300000;
+    auto countOf = [](std::size_t p) { return static_cast<long>(p % 7); };
+#ifdef _OPENMP
+    const auto maxThreads = omp_get_max_threads();
+    omp_set_num_threads(4);
+#endif
+    const auto displacements = Displacements<long>(n, countOf);
+#ifdef _OPENMP
+    omp_set_num_threads(maxThreads);
+#endif
+
+    REQUIRE(displacements.size() == n);
+    long sum = 0;
+    bool matches = true;
+    for (std::size_t p = 0; p < n; ++p) {
+        matches = matches && displacements[p] == sum;
+        sum += countOf(p);
+    }
+    CHECK(matches);
+    CHECK(displacements.back() == sum);
+
+    std::vector<int> count{0, 4, 0, 0, 1, 0, 2, 0};
+    const auto fromIterators = Displacements<int>(count.begin(), count.end());
+    std::istringstream stream("0 4 0 0 1 0 2 0");
+    const auto fromStream = Displacements<int>(std::istream_iterator<int>(stream),
+                                               std::istream_iterator<int>());
+    REQUIRE(fromIterators.size() == count.size());
+    REQUIRE(fromStream.size() == count.size());
+    for (std::size_t p = 0; p <= count.size(); ++p) {
+        CHECK(fromIterators[p] == Displacements<int>(count)[p]);
+        CHECK(fromStream[p] == fromIterators[p]);
+    }
+}
+
+TEST_CASE("Compact displacements") {
+    std::vector<int> count{0, 4, 0, 0, 1, 0, 2, 0};
+    const auto displacements = Displacements<std::size_t>(count);
+    const auto compact = CompactDisplacements(displacements);
+    CHECK(compact.isCompact());
+    CHECK(compact.bytes() == (count.size() + 1) * sizeof(std::uint32_t));
+    REQUIRE(compact.size() == count.size());
+    for (std::size_t p = 0; p < count.size(); ++p) {
+        CHECK(compact[p] == displacements[p]);
+        CHECK(compact.count(p) == displacements.count(p));
+    }
+    CHECK(compact.back() == 7);
+    CHECK(compact.visit([](auto const& displs) { return sizeof(displs[0]); }) == 4);
+
+    constexpr std::size_t large = std::size_t(1) << 31;
+    const auto wide = CompactDisplacements(3, [](std::size_t) { return large; });
+    CHECK(!wide.isCompact());
+    CHECK(wide.back() == 3 * large);
+    CHECK(wide[2] == 2 * large);
+
+    constexpr std::size_t n = 300000;
+    std::atomic<std::size_t> numCalls = 0;
+    auto countOf = [&numCalls](std::size_t p) {
+        ++numCalls;
+        return p % 7;
+    };
+#ifdef _OPENMP
+    const auto maxThreads = omp_get_max_threads();
+    omp_set_num_threads(4);
+#endif
+    const auto fromCounts = CompactDisplacements(n, countOf);
+    CHECK(numCalls == 2 * n);
+    numCalls = 0;
+    const auto fromTotal = CompactDisplacements(n, countOf, fromCounts.back());
+    CHECK(numCalls == n);
+    numCalls = 0;
+    const auto generated = Displacements<std::uint64_t>(n, countOf);
+    CHECK(numCalls == n);
+#ifdef _OPENMP
+    omp_set_num_threads(maxThreads);
+#endif
+    CHECK(fromTotal.isCompact());
+    CHECK(fromTotal.back() == generated.back());
+    CHECK(fromTotal[n / 2] == generated[n / 2]);
+}
+
+TEST_CASE("Owner lookup and flat iteration") {
+    std::vector<int> count{0, 4, 0, 0, 1, 0, 2, 0, 9, 3};
+    const auto displacements = Displacements<int>(count);
+    std::vector<std::size_t> owners;
+    for (auto [p, i] : displacements) {
+        owners.push_back(p);
+    }
+    REQUIRE(owners.size() == static_cast<std::size_t>(displacements.back()));
+
+    for (std::size_t itemsPerSample : {1, 2, 4, 64}) {
+        const auto index = mneme::OwnerIndex<int>(displacements, itemsPerSample);
+        CHECK(index.itemsPerSample() == itemsPerSample);
+        for (int i = 0; i < displacements.back(); ++i) {
+            CHECK(displacements.owner(i) == owners[i]);
+            CHECK(index.owner(i) == owners[i]);
+        }
+    }
+
+    constexpr std::size_t numChunks = 3;
+    std::vector<std::pair<std::size_t, int>> pairs;
+    for (std::size_t c = 0; c < numChunks; ++c) {
+        const auto [first, last] = displacements.chunk(c, numChunks);
+        CHECK(last - first >= displacements.back() / static_cast<int>(numChunks));
+        displacements.forEachItem(first, last, [&](std::size_t p, int i) {
+            pairs.emplace_back(p, i);
+        });
+    }
+    REQUIRE(pairs.size() == owners.size());
+    for (std::size_t i = 0; i < pairs.size(); ++i) {
+        CHECK(pairs[i].first == owners[i]);
+        CHECK(pairs[i].second == static_cast<int>(i));
+    }
+
+    std::vector<int> visits(displacements.back(), 0);
+    displacements.forEachItemParallel([&](std::size_t p, int i) {
+        visits[i] += static_cast<int>(p == owners[i]);
+    });
+    CHECK(std::count(visits.begin(), visits.end(), 1) == displacements.back());
+}
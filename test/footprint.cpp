@@ -0,0 +1,109 @@
+#include "doctest.h"
+#include "mneme/footprint.hpp"
+#include "mneme/plan.hpp"
+#include "mneme/registry.hpp"
+#include "mneme/storage.hpp"
+
+#include <sstream>
+#include <vector>
+
+using namespace mneme;
+
+namespace {
+struct dofs {
+    using type = double;
+    using allocator = AlignedAllocator<type, 1024>;
+};
+struct material {
+    using type = float;
+    using allocator = AlignedAllocator<type, 1024>;
+};
+
+struct dofsPooled {
+    using type = double;
+    using allocator = PolymorphicAllocator<type, 64>;
+};
+
+struct Interior : public Layer {};
+struct Copy : public Layer {};
+} // namespace
+
+TEST_CASE("Memory footprint") {
+    const auto plan = LayeredPlan()
+                          .withDofs<Interior>(30, [](auto) { return 2U; })
+                          .withDofs<Copy>(10, [](auto) { return 4U; });
+    constexpr std::size_t size = 100;
+
+    SUBCASE("Dry run matches the allocation") {
+        using storage_t = MultiStorage<DataLayout::SoA, dofs, material>;
+        const auto estimate = estimateFootprint<storage_t>(plan);
+        CHECK(estimate.numEntries == size);
+        REQUIRE(estimate.ids.size() == 2);
+        CHECK(estimate.ids[0].bytes == size * sizeof(double));
+        CHECK(estimate.ids[1].bytes == size * sizeof(float));
+        // Both arrays are rounded up to a multiple of 1024 bytes.
+        CHECK(estimate.totalBytes == 2 * 1024);
+        CHECK(estimate.paddingBytes == 2 * 1024 - size * (sizeof(double) + sizeof(float)));
+        REQUIRE(estimate.layers.size() == 2);
+        CHECK(estimate.layers[0].numEntries == 60);
+        CHECK(estimate.layers[1].bytes == 40 * (sizeof(double) + sizeof(float)));
+        REQUIRE(estimate.clusterBytes.size() == 1);
+        CHECK(estimate.clusterBytes[0] == estimate.payloadBytes);
+
+        const auto liveBefore = MemoryRegistry::liveBytes();
+        {
+            auto storage = storage_t(plan);
+            CHECK(MemoryRegistry::liveBytes() == liveBefore + estimate.totalBytes);
+            CHECK(MemoryRegistry::peakBytes() >= MemoryRegistry::liveBytes());
+            storage.reserve(200);
+            const auto grown = footprint(storage, plan);
+            CHECK(grown.capacity == 200);
+            CHECK(grown.unusedCapacityBytes == size * (sizeof(double) + sizeof(float)));
+            CHECK(MemoryRegistry::liveBytes() == liveBefore + grown.totalBytes);
+        }
+        CHECK(MemoryRegistry::liveBytes() == liveBefore);
+    }
+
+    SUBCASE("Bundled layouts") {
+        using aos_t = MultiStorage<DataLayout::AoS, dofs, material>;
+        const auto aos = estimateFootprint<aos_t>(size);
+        CHECK(aos.totalBytes == 2 * 1024);
+        CHECK(aos.paddingBytes == aos.totalBytes - aos.payloadBytes);
+
+        using aosoa_t = MultiStorage<AoSoA<8>, dofs, material>;
+        const auto aosoa = estimateFootprint<aosoa_t>(size);
+        CHECK(aosoa.totalBytes % 1024 == 0);
+        CHECK(aosoa.totalBytes >= 13 * 8 * (sizeof(double) + sizeof(float)));
+
+        const auto combinedPlan = CombinedLayeredPlan(std::vector{plan, plan});
+        const auto combined = estimateFootprint<aos_t>(combinedPlan);
+        CHECK(combined.layers.size() == 4);
+        REQUIRE(combined.clusterBytes.size() == 2);
+        CHECK(combined.clusterBytes[1] == combined.payloadBytes / 2);
+        CHECK(combined.layers[2].clusterId == 1);
+
+        std::ostringstream report;
+        report << combined;
+        CHECK(report.str().find("Interior") != std::string::npos);
+    }
+
+    SUBCASE("Pooled resources round up to the size class") {
+        using storage_t = MultiStorage<DataLayout::SoA, dofsPooled>;
+        constexpr std::size_t numEntries = 1025;
+        auto resource = PooledMemoryResource();
+        const auto bytes = numEntries * sizeof(double);
+        const auto pooled = estimateFootprint<storage_t>(numEntries, &resource);
+        CHECK(pooled.totalBytes == PooledMemoryResource::blockSizeOf(bytes));
+        CHECK(pooled.paddingBytes == pooled.totalBytes - bytes);
+        CHECK(estimateFootprint<storage_t>(numEntries).totalBytes == bytes);
+
+        const auto liveBefore = MemoryRegistry::liveBytes();
+        {
+            auto storage = storage_t(numEntries, &resource);
+            CHECK(footprint(storage).totalBytes == pooled.totalBytes);
+            CHECK(MemoryRegistry::liveBytes() == liveBefore + pooled.totalBytes);
+        }
+        CHECK(MemoryRegistry::liveBytes() == liveBefore);
+        CHECK(resource.cachedBytes() == pooled.totalBytes);
+    }
+}
@@ -0,0 +1,107 @@
+#include "doctest.h"
+#include "mneme/halo.hpp"
+#include "mneme/plan.hpp"
+#include "mneme/storage.hpp"
+
+#include <stdexcept>
+#include <vector>
+
+using namespace mneme;
+
+namespace {
+struct dofs {
+    using type = double;
+    using initialization = ValueInitialization;
+};
+struct material {
+    using type = int;
+    using initialization = ValueInitialization;
+};
+
+struct Interior : public Layer {};
+struct Copy : public Layer {};
+struct Ghost : public Layer {};
+
+template <typename Storage> void fillCopy(Storage& storage, std::size_t from, std::size_t to) {
+    for (auto i = from; i < to; ++i) {
+        storage[i].template get<dofs>() = static_cast<double>(i);
+        storage[i].template get<material>() = static_cast<int>(i) + 1;
+    }
+}
+} // namespace
+
+TEST_CASE("Halo exchange") {
+    const auto plan = LayeredPlan()
+                          .withDofs<Interior>(40, [](auto) { return 2U; })
+                          .withDofs<Copy>(10, [](auto i) { return 1U + i % 2U; })
+                          .withDofs<Ghost>(10, [](auto i) { return 1U + i % 2U; });
+    const auto& layout = plan.getLayout();
+    const auto copyFrom = layout[plan.getLayer<Copy>().offset];
+    const auto ghostFrom = layout[plan.getLayer<Ghost>().offset];
+    const auto numEntries = ghostFrom - copyFrom;
+
+    SUBCASE("SoA packs without copies") {
+        auto storage = MultiStorage<DataLayout::SoA, dofs, material>(plan);
+        fillCopy(storage, copyFrom, ghostFrom);
+        auto halo = HaloExchange<Copy, Ghost, dofs, material>(plan);
+        CHECK(halo.sendSize() == numEntries);
+        CHECK(halo.recvSize() == storage.size() - ghostFrom);
+
+        const auto send = halo.pack(storage);
+        CHECK(send[0].data() == reinterpret_cast<std::byte*>(&storage[copyFrom].get<dofs>()));
+        CHECK(send[1].size() == numEntries * sizeof(int));
+        const auto recv = halo.receiveBuffers(storage);
+        CHECK(recv[0].data() == reinterpret_cast<std::byte*>(&storage[ghostFrom].get<dofs>()));
+
+        auto transport = LoopbackTransport();
+        halo.exchange(storage, transport);
+        for (std::size_t i = 0; i < numEntries; ++i) {
+            CHECK(storage[ghostFrom + i].get<dofs>() == static_cast<double>(copyFrom + i));
+            CHECK(storage[ghostFrom + i].get<material>() == static_cast<int>(copyFrom + i) + 1);
+        }
+    }
+
+    SUBCASE("AoS and AoSoA go through buffers") {
+        auto sender = MultiStorage<DataLayout::AoS, dofs, material>(plan);
+        auto receiver = MultiStorage<AoSoA<4>, dofs, material>(plan);
+        fillCopy(sender, copyFrom, ghostFrom);
+        auto halo = HaloExchange<Copy, Ghost, material>(plan);
+        auto transport = LoopbackTransport();
+        const auto send = halo.pack(sender);
+        const auto recv = halo.receiveBuffers(receiver);
+        transport.send(0, send[0]);
+        transport.receive(0, recv[0]);
+        transport.wait();
+        halo.unpack(receiver);
+        for (std::size_t i = 0; i < numEntries; ++i) {
+            CHECK(receiver[ghostFrom + i].get<material>() == static_cast<int>(copyFrom + i) + 1);
+            CHECK(receiver[ghostFrom + i].get<dofs>() == 0.0);
+        }
+    }
+
+    SUBCASE("Clusters are packed back to back") {
+        const auto combinedPlan = CombinedLayeredPlan(std::vector{plan, plan});
+        auto storage = MultiStorage<DataLayout::SoA, dofs, material>(combinedPlan);
+        const auto second = combinedPlan.getClusterRange(1).first;
+        const auto& combinedLayout = combinedPlan.getLayout();
+        fillCopy(storage, copyFrom, ghostFrom);
+        fillCopy(storage, combinedLayout[second] + copyFrom, combinedLayout[second] + ghostFrom);
+        auto halo = HaloExchange<Copy, Ghost, dofs>(combinedPlan);
+        CHECK(halo.sendSize() == 2 * numEntries);
+
+        auto transport = LoopbackTransport();
+        halo.exchange(storage, transport);
+        const auto secondGhost = combinedLayout[second] + ghostFrom;
+        CHECK(storage[ghostFrom].get<dofs>() == static_cast<double>(copyFrom));
+        CHECK(storage[secondGhost].get<dofs>() ==
+              static_cast<double>(combinedLayout[second] + copyFrom));
+        CHECK(storage[secondGhost].get<material>() == 0);
+    }
+
+    SUBCASE("Mismatching messages are rejected") {
+        auto storage = MultiStorage<DataLayout::SoA, dofs>(plan);
+        auto halo = HaloExchange<Interior, Ghost, dofs>(plan);
+        auto transport = LoopbackTransport();
+        CHECK_THROWS_AS(halo.exchange(storage, transport), std::runtime_error);
+    }
+}
@@ -0,0 +1,165 @@
+#include "doctest.h"
+#include "mneme/mapped.hpp"
+#include "mneme/plan.hpp"
+#include "mneme/storage.hpp"
+#include "mneme/view.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+using namespace mneme;
+
+namespace {
+struct dofs {
+    using type = std::array<double, 4>;
+};
+struct material {
+    using type = double;
+};
+
+struct Interior : public Layer {};
+struct Copy : public Layer {};
+
+/**
+ * Unique path in the temporary directory, such that concurrent test runs do not collide.
+ */
+std::string tempPath(std::string const& name) {
+    static const auto prefix = "mneme-" + std::to_string(getpid()) + "-" +
+                               std::to_string(std::random_device()()) + "-";
+    return (std::filesystem::temp_directory_path() / (prefix + name)).string();
+}
+
+void patch(std::string const& path, std::size_t offset, std::uint64_t value) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.write(reinterpret_cast<char const*>(&value), sizeof(value));
+}
+} // namespace
+
+TEST_CASE("Memory-mapped storage") {
+    const auto plan = LayeredPlan()
+                          .withDofs<Interior>(100, [](auto) { return 1U; })
+                          .withDofs<Copy>(20, [](auto i) { return 1U + i % 3U; });
+    const auto layout = plan.getLayout();
+    const auto path = tempPath("mapped.bin");
+    const auto checkpointPath = tempPath("checkpoint.bin");
+
+    SUBCASE("SoA storage survives reopening") {
+        using storage_t = MappedStorage<DataLayout::SoA, dofs, material>;
+        {
+            auto storage = std::make_shared<storage_t>(path, plan);
+            REQUIRE(storage->size() == layout.back());
+            CHECK(storage->hasLayout());
+            auto view = createViewFactory()
+                            .withPlan(plan)
+                            .withStorage(storage)
+                            .createDenseView<Interior>();
+            for (std::size_t i = 0; i < view.size(); ++i) {
+                view[i].get<material>() = static_cast<double>(i);
+                view[i].get<dofs>()[3] = -static_cast<double>(i);
+            }
+            storage->sync();
+        }
+
+        auto storage = std::make_shared<storage_t>(path);
+        REQUIRE(storage->size() == layout.back());
+        const auto restored = storage->layout();
+        REQUIRE(restored.size() == layout.size());
+        for (std::size_t i = 0; i <= layout.size(); ++i) {
+            CHECK(restored[i] == layout[i]);
+        }
+        auto view = createViewFactory()
+                        .withPlan(plan)
+                        .withStorage(storage)
+                        .createDenseView<Interior>();
+        for (std::size_t i = 0; i < view.size(); ++i) {
+            CHECK(view[i].get<material>() == static_cast<double>(i));
+            CHECK(view[i].get<dofs>()[3] == -static_cast<double>(i));
+        }
+
+        auto checkpoint = storage->checkpoint(checkpointPath);
+        (*storage)[0].get<material>() = 42.0;
+        CHECK(checkpoint[0].get<material>() == 0.0);
+        const auto last = layout.back() - 1;
+        CHECK(checkpoint[last].get<dofs>() == (*storage)[last].get<dofs>());
+    }
+
+    SUBCASE("Private mappings leave the file untouched") {
+        using storage_t = MappedStorage<DataLayout::AoS, dofs, material>;
+        {
+            auto storage = storage_t(path, layout.back());
+            CHECK(!storage.hasLayout());
+            CHECK_THROWS_AS(storage.layout(), std::runtime_error);
+            storage[5].get<material>() = 5.0;
+        }
+        {
+            auto storage = storage_t(path, MapMode::Private);
+            CHECK(storage[5].get<material>() == 5.0);
+            storage[5].get<material>() = 6.0;
+        }
+        auto storage = storage_t(path);
+        CHECK(storage[5].get<material>() == 5.0);
+    }
+
+    SUBCASE("AoSoA and single storages") {
+        using storage_t = MappedStorage<AoSoA<4>, dofs, material>;
+        {
+            auto storage = storage_t(path, 13);
+            for (std::size_t i = 0; i < storage.size(); ++i) {
+                storage[i].get<material>() = static_cast<double>(i);
+            }
+        }
+        auto storage = storage_t(path);
+        for (std::size_t i = 0; i < storage.size(); ++i) {
+            CHECK(storage[i].get<material>() == static_cast<double>(i));
+        }
+
+        {
+            auto single = MappedSingleStorage<material>(checkpointPath, 10);
+            single[9] = 9.0;
+        }
+        auto single = MappedSingleStorage<material>(checkpointPath);
+        CHECK(single[9] == 9.0);
+    }
+
+    SUBCASE("Mismatching files are rejected") {
+        using storage_t = MappedStorage<DataLayout::SoA, dofs, material>;
+        using aos_t = MappedStorage<DataLayout::AoS, dofs, material>;
+        using swapped_t = MappedStorage<DataLayout::SoA, material, dofs>;
+        { auto storage = storage_t(path, 10); }
+        CHECK_THROWS_AS(aos_t{path}, std::runtime_error);
+        CHECK_THROWS_AS(swapped_t{path}, std::runtime_error);
+        CHECK_THROWS_AS(storage_t{tempPath("missing.bin")}, std::system_error);
+    }
+
+    SUBCASE("Corrupt headers are rejected") {
+        using storage_t = MappedStorage<DataLayout::SoA, dofs, material>;
+        using header_t = detail::MappedStorageHeader;
+        constexpr auto huge = std::numeric_limits<std::uint64_t>::max() - 4095;
+        auto checkRejected = [&](std::size_t offset, std::uint64_t value) {
+            { auto storage = storage_t(path, plan); }
+            patch(path, offset, value);
+            CHECK_THROWS_AS(storage_t{path}, std::runtime_error);
+        };
+        checkRejected(offsetof(header_t, layoutSize), 1000);
+        checkRejected(offsetof(header_t, layoutSize), huge);
+        checkRejected(offsetof(header_t, dataOffset), huge);
+        checkRejected(offsetof(header_t, dataBytes), huge);
+        checkRejected(offsetof(header_t, size), std::uint64_t(1) << 62U);
+        checkRejected(sizeof(header_t) + 5 * sizeof(std::uint64_t), 1);
+    }
+
+    std::remove(path.c_str());
+    std::remove(checkpointPath.c_str());
+}
@@ -4,10 +4,24 @@
 
 #include "doctest.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <numeric>
 #include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 using namespace mneme;
 
 struct ElasticMaterial {
@@ -32,6 +46,44 @@ struct bc {
     using allocator = StandardAllocator<type>;
 };
 
+struct valueInitialized {
+    using type = double;
+    using initialization = ValueInitialization;
+};
+struct TwiceThePosition {
+    double operator()(std::size_t pos) const { return 2.0 * pos; }
+};
+struct functorInitialized {
+    using type = double;
+    using initialization = FunctorInitialization<TwiceThePosition>;
+};
+struct neighbours {
+    using type = std::vector<int>;
+};
+
+struct Tracked {
+    static inline std::atomic<int> numAlive = 0;
+    Tracked() { ++numAlive; }
+    Tracked(Tracked const&) { ++numAlive; }
+    Tracked& operator=(Tracked const&) = default;
+    ~Tracked() { --numAlive; }
+};
+struct tracked {
+    using type = Tracked;
+};
+struct FailAfter44 {
+    double operator()(std::size_t pos) const {
+        if (pos == 45) {
+            throw std::runtime_error("Initialization failed.");
+        }
+        return pos;
+    }
+};
+struct failing {
+    using type = double;
+    using initialization = FunctorInitialization<FailAfter44>;
+};
+
 struct Ghost : public Layer {};
 struct Interior : public Layer {};
 struct Copy : public Layer {};
@@ -60,8 +112,10 @@ TEST_CASE("Data structure works") {
 
     using aos_t = MultiStorage<DataLayout::AoS, material, bc>;
     using soa_t = MultiStorage<DataLayout::SoA, material, bc>;
+    using aosoa_t = MultiStorage<AoSoA<4>, material, bc>;
     auto localAoS = std::make_shared<aos_t>(localLayout.back());
     auto localSoA = std::make_shared<soa_t>(localLayout.back());
+    auto localAoSoA = std::make_shared<aosoa_t>(localLayout.back());
     auto testMaterial = [](auto&& X) {
         for (int i = 0; i < static_cast<int>(X.size()); ++i) {
             X[i].template get<material>() = ElasticMaterial{1.0 * i, 1.0 * i, 2.0 * i};
@@ -76,6 +130,8 @@ TEST_CASE("Data structure works") {
 
     SUBCASE("MultiStorage SoA works") { testMaterial(*localSoA); }
 
+    SUBCASE("MultiStorage AoSoA works") { testMaterial(*localAoSoA); }
+
     SUBCASE("DenseView AoS works") {
         DenseView<aos_t> localView(localLayout, localAoS, NghostP1, N);
         testMaterial(localView);
@@ -91,6 +147,11 @@ TEST_CASE("Data structure works") {
         testMaterial(localView);
     }
 
+    SUBCASE("DenseView AoSoA works") {
+        DenseView<aosoa_t> localView(localLayout, localAoSoA, NghostP1, N);
+        testMaterial(localView);
+    }
+
     SUBCASE("SingleStorage works") {
         using dofs_storage_t = SingleStorage<dofsAligned>;
         auto dofsC = std::make_shared<dofs_storage_t>(dofsLayout.back());
@@ -111,6 +172,55 @@ TEST_CASE("Data structure works") {
     }
 }
 
+TEST_CASE("AoSoA layout") {
+    constexpr std::size_t blockWidth = 4;
+    constexpr std::size_t numElements = 11;
+    constexpr std::size_t numDofs = 3;
+    using storage_t = MultiStorage<AoSoA<blockWidth>, material, dofs>;
+    CHECK(isAoSoA(AoSoA<blockWidth>));
+    CHECK(!isAoSoA(DataLayout::SoA));
+    CHECK(mneme::blockWidth(AoSoA<blockWidth>) == blockWidth);
+
+    SUBCASE("Entries of a block are contiguous per Id") {
+        storage_t storage(numElements);
+        for (std::size_t i = 0; i < numElements; ++i) {
+            storage[i].get<dofs>() = i;
+        }
+        for (std::size_t i = 0; i + 1 < numElements; ++i) {
+            const auto* cur = &storage[i].get<dofs>();
+            const auto* next = &storage[i + 1].get<dofs>();
+            if ((i + 1) % blockWidth != 0) {
+                CHECK(next == cur + 1);
+            } else {
+                CHECK(next != cur + 1);
+            }
+            CHECK(*cur == i);
+        }
+    }
+
+    SUBCASE("StridedView works") {
+        Plan dofsPlan(numElements);
+        for (std::size_t i = 0; i < numElements; ++i) {
+            dofsPlan.setDof(i, numDofs);
+        }
+        auto dofsLayout = dofsPlan.getLayout();
+        auto storage = std::make_shared<storage_t>(dofsLayout.back());
+        StridedView<storage_t, numDofs> dofsV(dofsLayout, storage, 1, numElements);
+        for (std::size_t i = 0; i < dofsV.size(); ++i) {
+            std::size_t j = 0;
+            auto element = dofsV[i];
+            for (auto&& v : element.get<dofs>()) {
+                v = 100 * i + j++;
+            }
+            CHECK(j == numDofs);
+        }
+        for (std::size_t k = numDofs; k < dofsLayout.back(); ++k) {
+            const auto i = k / numDofs - 1;
+            CHECK((*storage)[k].get<dofs>() == 100 * i + k % numDofs);
+        }
+    }
+}
+
 TEST_CASE("Layered Plans") {
     constexpr std::size_t numInterior = 100;
     constexpr std::size_t numCopy = 30;
@@ -253,3 +363,671 @@ TEST_CASE("Layered Plans") {
         }
     }
 }
+
+TEST_CASE("Initialization policies") {
+    CHECK(std::is_same_v<InitializationGetter<dofs>::type, NoInitialization>);
+    CHECK(std::is_same_v<InitializationGetter<neighbours>::type, ValueInitialization>);
+    CHECK(std::is_same_v<InitializationGetter<valueInitialized>::type, ValueInitialization>);
+
+    constexpr std::size_t numInterior = 40;
+    constexpr std::size_t numCopy = 13;
+    constexpr auto dofsInterior = [](auto) { return 3U; };
+    constexpr auto dofsCopy = [](auto) { return 2U; };
+    const auto plan = LayeredPlan()
+                          .withDofs<Interior>(numInterior, dofsInterior)
+                          .withDofs<Copy>(numCopy, dofsCopy);
+    const auto& layout = plan.getLayout();
+
+    auto checkStorage = [&](auto const& storage) {
+        REQUIRE(storage.size() == layout.back());
+        for (std::size_t i = 0; i < storage.size(); ++i) {
+            CHECK(storage[i].template get<valueInitialized>() == 0.0);
+            CHECK(storage[i].template get<functorInitialized>() == 2.0 * i);
+            CHECK(storage[i].template get<neighbours>().empty());
+        }
+    };
+
+    SUBCASE("SoA from size") {
+        MultiStorage<DataLayout::SoA, valueInitialized, functorInitialized, neighbours> storage(
+            layout.back());
+        checkStorage(storage);
+    }
+    SUBCASE("SoA from layered plan") {
+        MultiStorage<DataLayout::SoA, valueInitialized, functorInitialized, neighbours> storage(
+            plan);
+        checkStorage(storage);
+    }
+    SUBCASE("AoS from combined plan") {
+        const auto combinedPlan = CombinedLayeredPlan(std::vector{plan, plan});
+        MultiStorage<DataLayout::AoS, valueInitialized, functorInitialized, neighbours> storage(
+            combinedPlan);
+        CHECK(storage.size() == 2 * layout.back());
+        for (std::size_t i = 0; i < storage.size(); ++i) {
+            CHECK(storage[i].get<functorInitialized>() == 2.0 * i);
+        }
+    }
+    SUBCASE("AoSoA after resize") {
+        MultiStorage<AoSoA<4>, valueInitialized, functorInitialized, neighbours> storage(3);
+        storage.resize(layout.back());
+        checkStorage(storage);
+    }
+}
+
+TEST_CASE("Failing initialization policies") {
+#ifdef _OPENMP
+    const auto maxThreads = omp_get_max_threads();
+    omp_set_num_threads(4);
+#endif
+    const auto plan = LayeredPlan().withDofs<Interior>(30, [](auto) { return 2U; });
+
+    SUBCASE("SoA from size") {
+        using storage_t = MultiStorage<DataLayout::SoA, tracked, failing>;
+        CHECK_THROWS_AS(static_cast<void>(storage_t(100)), std::runtime_error);
+    }
+    SUBCASE("AoS from layered plan") {
+        using storage_t = MultiStorage<DataLayout::AoS, tracked, failing>;
+        CHECK_THROWS_AS(static_cast<void>(storage_t(plan)), std::runtime_error);
+    }
+    SUBCASE("AoSoA insert") {
+        MultiStorage<AoSoA<4>, tracked, failing> storage(40);
+        CHECK_THROWS_AS(storage.insert(30, 20), std::runtime_error);
+        REQUIRE(storage.size() == 40);
+        CHECK(Tracked::numAlive == 40);
+        for (std::size_t i = 0; i < storage.size(); ++i) {
+            CHECK(storage[i].get<failing>() == i);
+        }
+    }
+    CHECK(Tracked::numAlive == 0);
+#ifdef _OPENMP
+    omp_set_num_threads(maxThreads);
+#endif
+}
+
+TEST_CASE("Data-preserving storage modifications") {
+    using storage_t = MultiStorage<DataLayout::SoA, dofs, neighbours>;
+    auto fill = [](auto& storage) {
+        for (std::size_t i = 0; i < storage.size(); ++i) {
+            storage[i].template get<dofs>() = i;
+            storage[i].template get<neighbours>() = std::vector<int>(1, static_cast<int>(i));
+        }
+    };
+    auto check = [](auto const& storage, std::vector<double> const& expected) {
+        REQUIRE(storage.size() == expected.size());
+        for (std::size_t i = 0; i < expected.size(); ++i) {
+            CHECK(storage[i].template get<dofs>() == expected[i]);
+            REQUIRE(storage[i].template get<neighbours>().size() <= 1);
+            if (!storage[i].template get<neighbours>().empty()) {
+                CHECK(storage[i].template get<neighbours>()[0] == expected[i]);
+            }
+        }
+    };
+
+    storage_t storage(5);
+    fill(storage);
+
+    SUBCASE("Resize and reserve preserve entries") {
+        storage.reserve(20);
+        CHECK(storage.capacity() == 20);
+        check(storage, {0, 1, 2, 3, 4});
+        storage.resize(7);
+        CHECK(storage.capacity() == 20);
+        CHECK(storage[6].get<neighbours>().empty());
+        storage.resize(3);
+        check(storage, {0, 1, 2});
+        storage.shrink_to_fit();
+        CHECK(storage.capacity() == 3);
+        check(storage, {0, 1, 2});
+    }
+
+    SUBCASE("Insert reallocating") {
+        storage.insert(2, 2);
+        CHECK(storage[2].get<neighbours>().empty());
+        CHECK(storage[3].get<neighbours>().empty());
+        storage[2].get<dofs>() = -1;
+        storage[3].get<dofs>() = -1;
+        check(storage, {0, 1, -1, -1, 2, 3, 4});
+    }
+
+    SUBCASE("Insert in place") {
+        storage.reserve(10);
+        storage.insert(1, 3);
+        for (std::size_t i = 1; i < 4; ++i) {
+            CHECK(storage[i].get<neighbours>().empty());
+            storage[i].get<dofs>() = -1;
+        }
+        check(storage, {0, -1, -1, -1, 1, 2, 3, 4});
+        storage.insert(8, 1);
+        storage[8].get<dofs>() = -2;
+        check(storage, {0, -1, -1, -1, 1, 2, 3, 4, -2});
+    }
+
+    SUBCASE("Erase ranges") {
+        storage.erase({{0, 1}, {2, 4}});
+        check(storage, {1, 4});
+        storage.erase(1, 2);
+        check(storage, {1});
+        CHECK_THROWS_AS(storage.erase({{0, 1}, {0, 1}}), std::invalid_argument);
+    }
+
+    SUBCASE("AoSoA and AoS storages") {
+        MultiStorage<AoSoA<4>, dofs, neighbours> aosoa(6);
+        MultiStorage<DataLayout::AoS, dofs, neighbours> aos(6);
+        fill(aosoa);
+        fill(aos);
+        aosoa.insert(3, 3);
+        aos.insert(3, 3);
+        for (std::size_t i = 3; i < 6; ++i) {
+            aosoa[i].get<dofs>() = -1;
+            aos[i].get<dofs>() = -1;
+        }
+        aosoa.erase({{0, 2}});
+        aos.erase({{0, 2}});
+        check(aosoa, {2, -1, -1, -1, 3, 4, 5});
+        check(aos, {2, -1, -1, -1, 3, 4, 5});
+    }
+
+    SUBCASE("Layered plan and storage") {
+        auto plan = LayeredPlan()
+                        .withDofs<Interior>(4, [](auto) { return 2U; })
+                        .withDofs<Copy>(3, [](auto) { return 1U; })
+                        .withDofs<Ghost>(2, [](auto) { return 3U; });
+        auto dofsStorage = SingleStorage<dofs>(plan);
+        for (std::size_t i = 0; i < dofsStorage.size(); ++i) {
+            dofsStorage[i] = i;
+        }
+        insertElements<Interior>(plan, dofsStorage, 1, {5, 1});
+        CHECK(plan.getLayer<Interior>().numElements == 6);
+        CHECK(plan.getLayer<Copy>().offset == 6);
+        CHECK(plan.getLayer<Ghost>().offset == 9);
+        CHECK(plan.size() == 11);
+        const auto& layout = plan.getLayout();
+        CHECK(layout.back() == dofsStorage.size());
+        CHECK(layout.count(1) == 5);
+        CHECK(dofsStorage[layout[3]] == 2.0);
+
+        eraseElements<Copy>(plan, dofsStorage, {{0, 1}, {2, 3}});
+        CHECK(plan.getLayer<Copy>().numElements == 1);
+        CHECK(plan.getLayer<Ghost>().offset == 7);
+        const auto& newLayout = plan.getLayout();
+        CHECK(newLayout.back() == dofsStorage.size());
+        // The remaining Copy element originally stored entry 9.
+        CHECK(dofsStorage[newLayout[6]] == 9.0);
+        CHECK(dofsStorage[newLayout[7]] == 11.0);
+
+        CHECK_THROWS_AS(insertElements<Copy>(plan, dofsStorage, 2, {1}), std::out_of_range);
+        CHECK(plan.getLayout().back() == dofsStorage.size());
+        CHECK(plan.getLayer<Copy>().numElements == 1);
+    }
+}
+
+struct rho {
+    using type = double;
+    using initialization = FunctorInitialization<TwiceThePosition>;
+};
+struct mu {
+    using type = double;
+    using initialization = ValueInitialization;
+};
+struct lambda {
+    using type = double;
+};
+
+TEST_CASE("Grouped Ids") {
+    using elastic_t = Group<rho, mu, lambda>;
+    constexpr std::size_t size = 37;
+    CHECK(std::is_same_v<elastic_t::type, tagged_tuple<rho, mu, lambda>>);
+
+    auto checkStorage = [&](auto& storage) {
+        REQUIRE(storage.size() == size);
+        for (std::size_t i = 0; i < size; ++i) {
+            CHECK(storage[i].template get<rho>() == 2.0 * i);
+            CHECK(storage[i].template get<mu>() == 0.0);
+            CHECK(storage[i].template get<neighbours>().empty());
+            storage[i].template get<lambda>() = 3.0 * i;
+            storage[i].template get<bc>()[1] = static_cast<int>(i);
+        }
+        for (std::size_t i = 0; i < size; ++i) {
+            // Grouped Ids share a tuple.
+            const auto* group = &storage[i].template get<elastic_t>();
+            CHECK(&storage[i].template get<lambda>() == &group->template get<lambda>());
+            CHECK(storage[i].template get<elastic_t>().template get<lambda>() == 3.0 * i);
+            CHECK(storage[i].template get<bc>()[1] == static_cast<int>(i));
+        }
+    };
+
+    SUBCASE("SoA of groups") {
+        MultiStorage<DataLayout::SoA, elastic_t, bc, Group<neighbours>> storage(size);
+        checkStorage(storage);
+        // Groups are contiguous arrays of bundles.
+        CHECK(&storage[1].get<elastic_t>() == &storage[0].get<elastic_t>() + 1);
+        storage.resize(2 * size);
+        CHECK(storage[2 * size - 1].get<rho>() == 2.0 * (2 * size - 1));
+        CHECK(storage[size - 1].get<lambda>() == 3.0 * (size - 1));
+    }
+    SUBCASE("AoS and AoSoA of groups") {
+        MultiStorage<DataLayout::AoS, elastic_t, bc, Group<neighbours>> aos(size);
+        checkStorage(aos);
+        MultiStorage<AoSoA<4>, elastic_t, bc, Group<neighbours>> aosoa(size);
+        checkStorage(aosoa);
+    }
+    SUBCASE("Views of groups") {
+        const auto plan = LayeredPlan().withDofs<Interior>(size, [](auto) { return 1U; });
+        auto storage =
+            std::make_shared<MultiStorage<DataLayout::SoA, elastic_t, bc, Group<neighbours>>>(
+                plan);
+        auto view =
+            createViewFactory().withPlan(plan).withStorage(storage).createDenseView<Interior>();
+        for (std::size_t i = 0; i < view.size(); ++i) {
+            CHECK(view[i].get<rho>() == 2.0 * i);
+        }
+    }
+    SUBCASE("Strided views of groups") {
+        constexpr std::size_t numDofs = 3;
+        const auto plan = LayeredPlan().withDofs<Interior>(size, [](auto) { return numDofs; });
+        using storage_t = MultiStorage<DataLayout::SoA, elastic_t, dofs>;
+        auto storage = std::make_shared<storage_t>(plan);
+        const auto factory = createViewFactory().withPlan(plan).withStorage(storage);
+        const auto view = factory.withStride<numDofs>().createStridedView<Interior>();
+        const auto dynamicView = factory.withDynamicStride().createStridedView<Interior>();
+        for (std::size_t i = 0; i < view.size(); ++i) {
+            auto rhos = view[i].get<rho>();
+            REQUIRE(rhos.size() == numDofs);
+            CHECK(dynamicView[i].get<mu>().size() == numDofs);
+            for (std::size_t j = 0; j < numDofs; ++j) {
+                CHECK(rhos[j] == 2.0 * (numDofs * i + j));
+                CHECK(&rhos[j] == &(*storage)[numDofs * i + j].get<rho>());
+            }
+            view[i].get<lambda>()[2] = 1.0;
+        }
+        CHECK((*storage)[numDofs * size - 1].get<lambda>() == 1.0);
+    }
+    SUBCASE("Element types of grouped Ids") {
+        using entry_t = MultiStorage<DataLayout::SoA, elastic_t, dofs>::value_type<1u>;
+        using strided_t = MultiStorage<DataLayout::SoA, elastic_t, dofs>::value_type<3u>;
+        CHECK(std::is_same_v<entry_t::element_t<rho>, double&>);
+        CHECK(std::is_same_v<entry_t::element_t<dofs>, double&>);
+        CHECK(std::is_same_v<strided_t::element_t<mu>, blocked_span<double, 1, 3>>);
+        CHECK(std::is_same_v<elastic_t::type::element_t<lambda>, double>);
+        CHECK(std::is_same_v<tagged_tuple<elastic_t, dofs>::element_t<rho>, double>);
+    }
+}
+
+TEST_CASE("Random-access iterators") {
+    constexpr std::size_t numElements = 20;
+    constexpr std::size_t numDofs = 3;
+    const auto plan =
+        LayeredPlan()
+            .withDofs<Ghost>(2, [](auto) { return numDofs; })
+            .withDofs<Interior>(numElements, [](auto) { return numDofs; });
+
+    SUBCASE("Spans iterate over raw pointers") {
+        using span_t = span<double>;
+        CHECK(std::is_same_v<span_t::iterator, double*>);
+        std::vector<double> values = {3.0, 1.0, 2.0};
+        auto s = span_t(values.data(), values.size());
+        std::sort(s.begin(), s.end());
+        CHECK(values == std::vector<double>{1.0, 2.0, 3.0});
+    }
+
+    SUBCASE("Strided views") {
+        using storage_t = MultiStorage<DataLayout::SoA, dofs, valueInitialized>;
+        auto storage = std::make_shared<storage_t>(plan);
+        auto view = createViewFactory()
+                        .withPlan(plan)
+                        .withStorage(storage)
+                        .withStride<numDofs>()
+                        .createStridedView<Interior>();
+        using iterator_t = decltype(view.begin());
+        CHECK(std::is_same_v<std::iterator_traits<iterator_t>::iterator_category,
+                             std::random_access_iterator_tag>);
+        CHECK(view.end() - view.begin() == static_cast<std::ptrdiff_t>(numElements));
+
+        for (auto it = view.begin(); it != view.end(); ++it) {
+            auto element = *it;
+            for (std::size_t j = 0; j < numDofs; ++j) {
+                element.get<dofs>()[j] = static_cast<double>(it - view.begin());
+            }
+        }
+        for (std::size_t i = 0; i < numElements; ++i) {
+            CHECK(view[i].get<dofs>()[numDofs - 1] == static_cast<double>(i));
+        }
+        const auto it = view.begin() + 7;
+        CHECK(&(*it).get<dofs>()[0] == &view[7].get<dofs>()[0]);
+        CHECK(&it[-3].get<dofs>()[0] == &view[4].get<dofs>()[0]);
+        CHECK(&(*(it - 7)).get<dofs>()[0] == &(*view.begin()).get<dofs>()[0]);
+        CHECK((it > view.begin() && it <= view.end() && view.begin() < it));
+        auto back = view.end();
+        --back;
+        CHECK(&(*back).get<dofs>()[0] == &view[numElements - 1].get<dofs>()[0]);
+    }
+
+    SUBCASE("Dense views over single storages work with standard algorithms") {
+        const auto densePlan =
+            LayeredPlan().withDofs<Interior>(numElements, [](auto) { return 1U; });
+        auto storage = std::make_shared<SingleStorage<dofs>>(densePlan.getLayout().back());
+        auto view = createViewFactory()
+                        .withPlan(densePlan)
+                        .withStorage(storage)
+                        .createDenseView<Interior>();
+        CHECK(std::is_same_v<decltype(*view.begin()), double&>);
+        std::iota(view.begin(), view.end(), 0.0);
+        std::reverse(view.begin(), view.end());
+        std::sort(view.begin(), view.end());
+        CHECK(std::is_sorted(view.begin(), view.end()));
+        CHECK(*std::lower_bound(view.begin(), view.end(), 5.0) == 5.0);
+        CHECK((*storage)[numElements - 1] == numElements - 1);
+    }
+
+    SUBCASE("Storages") {
+        auto storage = MultiStorage<AoSoA<4>, dofs, valueInitialized>(10);
+        const auto begin = storage.begin();
+        CHECK(storage.end() - begin == 10);
+        CHECK(&begin[9].get<dofs>() == &storage[9].get<dofs>());
+        CHECK(begin + 3 == storage.end() - 7);
+    }
+}
+
+TEST_CASE("General views with compact offsets") {
+    const auto plan = LayeredPlan()
+                          .withDofs<Ghost>(3, [](auto i) { return 1U + i; })
+                          .withDofs<Interior>(10, [](auto i) { return 1U + i % 3U; });
+    const auto compactLayout = plan.getCompactLayout();
+    CHECK(compactLayout.isCompact());
+    CHECK(compactLayout.back() == plan.getLayout().back());
+
+    using storage_t = MultiStorage<DataLayout::SoA, dofs>;
+    auto storage = std::make_shared<storage_t>(plan.getLayout().back());
+    for (std::size_t i = 0; i < storage->size(); ++i) {
+        (*storage)[i].get<dofs>() = static_cast<double>(i);
+    }
+    const auto& layer = plan.getLayer<Interior>();
+    const auto from = layer.offset;
+    const auto to = layer.offset + layer.numElements;
+    auto view = GeneralView<storage_t, std::uint32_t>(compactLayout, storage, from, to);
+    auto wideView = GeneralView<storage_t>(plan.getLayout(), storage, from, to);
+    REQUIRE(view.size() == layer.numElements);
+    for (std::size_t i = 0; i < view.size(); ++i) {
+        auto element = view[i].get<dofs>();
+        CHECK(element.size() == 1 + i % 3);
+        CHECK(element[0] == static_cast<double>(plan.getLayout()[from + i]));
+        CHECK(wideView[i].get<dofs>().data() == element.data());
+    }
+    CHECK_THROWS_AS((GeneralView<storage_t, std::uint8_t>(
+                        Displacements<std::size_t>(std::vector<std::size_t>{300}), storage, 0, 1)),
+                    std::runtime_error);
+}
+
+TEST_CASE("Building layered plans in place") {
+    auto dofsInterior = [](auto i) { return 1U + i % 4U; };
+    const std::vector<std::size_t> dofsCopy = {3, 1, 4, 1, 5};
+    auto copyDof = [&dofsCopy](auto i) { return dofsCopy[i]; };
+    const auto reference = LayeredPlan()
+                               .withDofs<Interior>(20, dofsInterior)
+                               .withDofs<Copy>(dofsCopy.size(), copyDof);
+    auto checkSame = [&reference, &dofsCopy](auto const& plan) {
+        REQUIRE(plan.size() == reference.size());
+        CHECK(plan.template getLayer<Copy>().offset == reference.getLayer<Copy>().offset);
+        CHECK(plan.template getLayer<Copy>().numElements == dofsCopy.size());
+        for (std::size_t i = 0; i <= reference.size(); ++i) {
+            CHECK(plan.getLayout()[i] == reference.getLayout()[i]);
+        }
+    };
+
+    SUBCASE("Moved-from builder") {
+        auto interiorPlan = LayeredPlan().withDofs<Interior>(20, dofsInterior);
+        checkSame(std::move(interiorPlan).withDofs<Copy>(dofsCopy));
+    }
+    SUBCASE("Copied builder keeps the original") {
+        const auto interiorPlan = LayeredPlan().withDofs<Interior>(20, dofsInterior);
+        checkSame(interiorPlan.withDofs<Copy>(span<const std::size_t>(dofsCopy.data(), 5)));
+        CHECK(interiorPlan.size() == 20);
+        CHECK(interiorPlan.getLayout().back() == 50);
+    }
+    SUBCASE("Parallel fill") {
+        constexpr std::size_t n = 200000;
+#ifdef _OPENMP
+        const auto maxThreads = omp_get_max_threads();
+        omp_set_num_threads(4);
+#endif
+        const auto plan = LayeredPlan().withDofsParallel<Interior>(n, dofsInterior);
+        auto throwing = [](std::size_t i) -> std::size_t {
+            if (i == n - 1) {
+                throw std::runtime_error("Invalid element.");
+            }
+            return 1;
+        };
+        CHECK_THROWS_AS(static_cast<void>(LayeredPlan().withDofsParallel<Interior>(n, throwing)),
+                        std::runtime_error);
+        // withDofs calls func serially and in order.
+        std::size_t next = 0;
+        bool ordered = true;
+        const auto serialPlan = LayeredPlan().withDofs<Interior>(n, [&](std::size_t i) {
+            ordered = ordered && i == next++;
+            return dofsInterior(i);
+        });
+#ifdef _OPENMP
+        omp_set_num_threads(maxThreads);
+#endif
+        CHECK(ordered);
+        CHECK(next == n);
+        const auto& layout = plan.getLayout();
+        REQUIRE(layout.size() == n);
+        bool matches = true;
+        for (std::size_t i = 0; i < n; ++i) {
+            matches = matches && layout.count(i) == dofsInterior(i);
+        }
+        CHECK(matches);
+        CHECK(serialPlan.getLayout().back() == layout.back());
+    }
+}
+
+TEST_CASE("Concurrent layout queries") {
+    const auto plan = LayeredPlan()
+                          .withDofs<Interior>(1000, [](auto i) { return 1U + i % 4U; })
+                          .withDofs<Copy>(10, [](auto) { return 2U; });
+    const auto combinedPlan = CombinedLayeredPlan(std::vector{plan, plan});
+    constexpr std::size_t numThreads = 4;
+    std::vector<std::shared_ptr<const LayeredPlan<Interior, Copy>::layout_t>> layouts(numThreads);
+    std::vector<std::shared_ptr<const LayeredPlan<Interior, Copy>::layout_t>> combinedLayouts(
+        numThreads);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < numThreads; ++t) {
+        threads.emplace_back([&, t] {
+            layouts[t] = plan.getSharedLayout();
+            combinedLayouts[t] = combinedPlan.getSharedLayout();
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (std::size_t t = 0; t < numThreads; ++t) {
+        CHECK(layouts[t] == layouts[0]);
+        CHECK(combinedLayouts[t] == combinedLayouts[0]);
+    }
+    CHECK(layouts[0]->back() == 2520);
+    CHECK(combinedLayouts[0]->back() == 2 * layouts[0]->back());
+}
+
+TEST_CASE("Run-length layouts") {
+    auto irregular = [](auto i) { return 1U + i % 3U; };
+    const auto plan = LayeredPlan()
+                          .withDofs<Interior>(1000, [](auto) { return 10U; })
+                          .withDofs<Copy>(8, irregular)
+                          .withDofs<Ghost>(500, [](auto) { return 4U; });
+    const auto& layout = plan.getLayout();
+    const auto runLayout = plan.getRunLengthLayout();
+    CHECK(runLayout.numRuns() == 3);
+    CHECK(runLayout.bytes() < layout.size() * sizeof(std::size_t) / 10);
+    REQUIRE(runLayout.size() == layout.size());
+    for (std::size_t i = 0; i <= layout.size(); ++i) {
+        CHECK(runLayout[i] == layout[i]);
+    }
+    CHECK(runLayout.count(1003) == irregular(3));
+
+    SUBCASE("Combined plan") {
+        const auto combinedPlan = CombinedLayeredPlan(std::vector{plan, plan});
+        const auto combinedLayout = combinedPlan.getLayout();
+        const auto combinedRunLayout = combinedPlan.getRunLengthLayout();
+        CHECK(combinedRunLayout.numRuns() == 6);
+        CHECK(combinedRunLayout.back() == combinedLayout.back());
+        for (std::size_t i = 0; i <= combinedLayout.size(); i += 7) {
+            CHECK(combinedRunLayout[i] == combinedLayout[i]);
+        }
+        const auto combinedCompactLayout = combinedPlan.getCompactLayout();
+        CHECK(combinedCompactLayout.isCompact());
+        CHECK(combinedCompactLayout.back() == 2 * plan.numberOfDofs());
+        CHECK(combinedCompactLayout.back() == combinedLayout.back());
+        CHECK(combinedCompactLayout[plan.size() + 3] == combinedLayout[plan.size() + 3]);
+    }
+    SUBCASE("Irregular layouts") {
+        const auto displacements = Displacements<std::size_t>(std::vector<std::size_t>(100, 2));
+        CHECK(RunLengthDisplacements(displacements).numRuns() == 1);
+        CHECK(RunLengthDisplacements(displacements, 101).numRuns() == 1);
+        CHECK(RunLengthDisplacements(displacements, 101).back() == 200);
+        CHECK(RunLengthDisplacements().size() == 0);
+        CHECK(RunLengthDisplacements().back() == 0);
+    }
+    SUBCASE("View factory") {
+        using storage_t = MultiStorage<DataLayout::SoA, dofs>;
+        auto storage = std::make_shared<storage_t>(layout.back());
+        const auto factory = createViewFactory().withPlan(plan).withStorage(storage);
+        const auto runFactory = factory.withLayout(runLayout);
+        const auto view = factory.withStride<4>().createStridedView<Ghost>();
+        const auto runView = runFactory.withStride<4>().createStridedView<Ghost>();
+        REQUIRE(runView.size() == view.size());
+        CHECK(runView[0].get<dofs>().data() == view[0].get<dofs>().data());
+        auto generalView = GeneralView<storage_t>(runLayout, storage, 1000, 1008);
+        REQUIRE(generalView.size() == 8);
+        for (std::size_t i = 0; i < generalView.size(); ++i) {
+            CHECK(generalView[i].get<dofs>().size() == irregular(i));
+        }
+    }
+}
+
+template <typename Plan, typename = void> constexpr bool factoryTakesPlan = false;
+template <typename Plan>
+constexpr bool factoryTakesPlan<
+    Plan, std::void_t<decltype(createViewFactory().withPlan(std::declval<Plan>()))>> = true;
+
+TEST_CASE("Views share the layouts of plans") {
+    static_assert(factoryTakesPlan<LayeredPlan<Interior, Copy, Ghost> const&>);
+    static_assert(!factoryTakesPlan<LayeredPlan<Interior, Copy, Ghost>>);
+
+    auto plan = LayeredPlan()
+                    .withDofs<Interior>(100, [](auto) { return 6U; })
+                    .withDofs<Copy>(10, [](auto i) { return 1U + i % 2U; })
+                    .withDofs<Ghost>(0, [](auto) { return 2U; });
+    CHECK(plan.getLayer<Interior>().stride == 6);
+    CHECK_FALSE(plan.getLayer<Copy>().isUniform());
+    CHECK_FALSE(plan.getLayer<Ghost>().isUniform());
+
+    const auto layout = plan.getSharedLayout();
+    const auto planCopy = plan;
+    CHECK(planCopy.getSharedLayout() == layout);
+    CHECK(&plan.getLayout() == layout.get());
+
+    using storage_t = MultiStorage<DataLayout::SoA, dofs>;
+    auto storage = std::make_shared<storage_t>(layout->back() + 6);
+    const auto factory = createViewFactory().withPlan(plan).withStorage(storage);
+
+    SUBCASE("Plan modifications") {
+        plan.insert<Interior>(100, {6});
+        CHECK(plan.getLayer<Interior>().stride == 6);
+        CHECK(plan.getSharedLayout() != layout);
+        CHECK(layout->size() == 110);
+        const auto view = factory.withStride<6>().createStridedView<Interior>();
+        CHECK(view.size() == 101);
+        plan.insert<Interior>(0, {5});
+        CHECK_FALSE(plan.getLayer<Interior>().isUniform());
+        CHECK_THROWS_AS(static_cast<void>(factory.withStride<6>().createStridedView<Interior>()),
+                        std::runtime_error);
+        plan.erase<Interior>({{0, 1}});
+        CHECK(plan.getLayer<Interior>().isUniform());
+    }
+    SUBCASE("Strided views of uniform layers") {
+        const auto view = factory.withStride<6>().createStridedView<Interior>();
+        REQUIRE(view.size() == 100);
+        CHECK(&view[99].get<dofs>()[0] == &(*storage)[99 * 6].get<dofs>());
+        CHECK_THROWS_AS(static_cast<void>(factory.withStride<4>().createStridedView<Interior>()),
+                        std::runtime_error);
+    }
+    SUBCASE("General views") {
+        const auto useCount = layout.use_count();
+        auto view = factory.createGeneralView<Copy>();
+        CHECK(layout.use_count() == useCount + 1);
+        REQUIRE(view.size() == 10);
+        for (std::size_t i = 0; i < view.size(); ++i) {
+            CHECK(view[i].get<dofs>().size() == 1 + i % 2);
+            CHECK(view[i].get<dofs>().data() == &(*storage)[(*layout)[100 + i]].get<dofs>());
+        }
+    }
+    SUBCASE("Combined plans cache their layout") {
+        const auto combinedPlan = CombinedLayeredPlan(std::vector{planCopy, planCopy});
+        CHECK(&combinedPlan.getLayout() == &combinedPlan.getLayout());
+        CHECK(combinedPlan.getLayer<Interior>(1).stride == 6);
+    }
+}
+
+TEST_CASE("Borrowed views and kernel handles") {
+    const auto plan = LayeredPlan()
+                          .withDofs<Interior>(20, [](auto) { return 3U; })
+                          .withDofs<Copy>(5, [](auto i) { return 1U + i; });
+    using storage_t = MultiStorage<DataLayout::SoA, dofs, valueInitialized>;
+    auto storage = std::make_shared<storage_t>(plan.getLayout().back());
+    for (std::size_t i = 0; i < storage->size(); ++i) {
+        (*storage)[i].get<dofs>() = static_cast<double>(i);
+    }
+    const auto factory = createViewFactory().withPlan(plan).withStorage(storage);
+    const auto view = factory.withStride<3>().createStridedView<Interior>();
+    const auto useCount = storage.use_count();
+
+    SUBCASE("Borrowed strided views") {
+        const auto borrowed = view.borrow();
+        const auto copy = borrowed;
+        CHECK(storage.use_count() == useCount);
+        REQUIRE(copy.size() == view.size());
+        std::size_t i = 0;
+        for (auto&& element : copy) {
+            CHECK(element.get<dofs>().data() == view[i++].get<dofs>().data());
+        }
+        copy[4].get<valueInitialized>()[2] = 1.0;
+        CHECK((*storage)[14].get<valueInitialized>() == 1.0);
+    }
+    SUBCASE("Kernel handles") {
+        using handle_t = KernelHandle<storage_t, 3>;
+        static_assert(std::is_trivially_copyable_v<handle_t>);
+        const auto handle = view.kernelHandle();
+        CHECK(handle.size() == 20);
+        CHECK(handle.stride() == 3);
+        CHECK(handle.data<dofs>() == &(*storage)[0].get<dofs>());
+        for (std::size_t i = 0; i < handle.size(); ++i) {
+            CHECK(handle.get<dofs>(i)[1] == static_cast<double>(3 * i + 1));
+        }
+        auto dynamicView = factory.withDynamicStride().createStridedView<Interior>();
+        CHECK(dynamicView.kernelHandle().get<valueInitialized>(19).size() == 3);
+    }
+    SUBCASE("Borrowed general views") {
+        const auto generalView = factory.createGeneralView<Copy>();
+        const auto borrowed = generalView.borrow();
+        CHECK(storage.use_count() == useCount + 1);
+        REQUIRE(borrowed.size() == 5);
+        std::size_t i = 0;
+        for (auto&& element : borrowed) {
+            CHECK(element.get<dofs>().size() == 1 + i);
+            CHECK(element.get<dofs>()[0] == static_cast<double>(plan.getLayout()[20 + i]));
+            ++i;
+        }
+    }
+    SUBCASE("Single storages") {
+        auto single = std::make_shared<SingleStorage<dofs>>(plan.getLayout().back());
+        const auto singleView = createViewFactory()
+                                    .withPlan(plan)
+                                    .withStorage(single)
+                                    .withStride<3>()
+                                    .createStridedView<Interior>();
+        const auto borrowed = singleView.borrow();
+        borrowed[2][1] = 5.0;
+        CHECK((*single)[7] == 5.0);
+        CHECK(singleView.kernelHandle().get<dofs>(2)[1] == 5.0);
+    }
+}
@@ -0,0 +1,144 @@
+#include "doctest.h"
+#include "mneme/numa.hpp"
+#include "mneme/plan.hpp"
+#include "mneme/storage.hpp"
+#include "mneme/view.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <system_error>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace mneme;
+
+namespace {
+struct dofs {
+    using type = double;
+    using initialization = ValueInitialization;
+};
+struct material {
+    using type = double;
+};
+
+struct uninitializedDofs {
+    using type = double;
+    using allocator = PolymorphicAllocator<type>;
+};
+
+struct Interior : public Layer {};
+struct Copy : public Layer {};
+
+int policyOf(void const* addr) {
+#ifdef __linux__
+    constexpr unsigned long mpolFAddr = 1U << 1U;
+    int mode = -1;
+    syscall(SYS_get_mempolicy, &mode, nullptr, 0UL, const_cast<void*>(addr), mpolFAddr);
+    return mode;
+#else
+    return -1;
+#endif
+}
+
+// Fills new memory with a pattern, such that writes of the constructor can be observed.
+class PoisonedResource : public std::pmr::memory_resource {
+public:
+    constexpr static unsigned char poison = 0xab;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+        auto* ptr = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        std::memset(ptr, poison, bytes);
+        return ptr;
+    }
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override {
+        std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+    }
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+        return this == &other;
+    }
+};
+} // namespace
+
+TEST_CASE("NUMA domain map") {
+    const auto plan = LayeredPlan()
+                          .withDofs<Interior>(1000, [](auto) { return 4U; })
+                          .withDofs<Copy>(200, [](auto) { return 1U; });
+    const auto combinedPlan = CombinedLayeredPlan(std::vector{plan, plan});
+    const auto layout = combinedPlan.getLayout();
+
+    CHECK(combinedPlan.numberOfClusters() == 2);
+    const auto map = NumaDomainMap::fromClusters(combinedPlan, {0, 0});
+    REQUIRE(map.ranges().size() == 2);
+    CHECK(map.ranges()[0].from == 0);
+    CHECK(map.ranges()[0].to == layout.back() / 2);
+    CHECK(map.ranges()[1].from == layout.back() / 2);
+    CHECK(map.ranges()[1].to == layout.back());
+    CHECK_THROWS_AS(NumaDomainMap::fromClusters(combinedPlan, {0}), std::invalid_argument);
+
+#ifdef __linux__
+    SUBCASE("Storage places clusters") {
+        using storage_t = MultiStorage<DataLayout::SoA, dofs, material>;
+        auto storage = std::make_shared<storage_t>(combinedPlan, map);
+        constexpr int mpolPreferred = 1;
+        const auto* last = &(*storage)[storage->size() - 1].get<dofs>();
+        CHECK(policyOf(last) == mpolPreferred);
+
+        auto view = createViewFactory()
+                        .withPlan(combinedPlan)
+                        .withStorage(storage)
+                        .withClusterId(1)
+                        .createDenseView<Copy>();
+        CHECK(view.size() == 200);
+        for (std::size_t i = 0; i < view.size(); ++i) {
+            CHECK(view[i].get<dofs>() == 0.0);
+        }
+    }
+
+    SUBCASE("Invalid nodes are rejected") {
+        using storage_t = MultiStorage<DataLayout::AoS, dofs>;
+        auto invalid = NumaDomainMap().add(0, 100000, 1 << 20);
+        CHECK_THROWS_AS(storage_t(100000, invalid), std::system_error);
+        auto tooLarge = NumaDomainMap().add(0, 11, 0);
+        CHECK_THROWS_AS(storage_t(10, tooLarge), std::out_of_range);
+    }
+#endif
+}
+
+TEST_CASE("Uninitialized Ids are placed on construction") {
+    const auto plan = LayeredPlan()
+                          .withDofs<Interior>(3000, [](auto) { return 4U; })
+                          .withDofs<Copy>(500, [](auto) { return 1U; });
+    PoisonedResource resource;
+    auto checkTouched = [&](auto const& storage) {
+        auto const* first =
+            reinterpret_cast<unsigned char const*>(&storage[0].template get<uninitializedDofs>());
+        auto const* last = first + storage.size() * sizeof(double);
+        const auto page = static_cast<std::uintptr_t>(pageSize());
+        auto const* firstPage =
+            first + (page - reinterpret_cast<std::uintptr_t>(first) % page) % page;
+        REQUIRE(firstPage + page < last);
+        bool touched = true;
+        for (auto const* byte = firstPage; byte < last; byte += page) {
+            touched = touched && *byte == 0;
+        }
+        CHECK(touched);
+        CHECK(firstPage[1] == PoisonedResource::poison);
+    };
+
+    SUBCASE("SoA") {
+        checkTouched(MultiStorage<DataLayout::SoA, uninitializedDofs>(plan, &resource));
+    }
+    SUBCASE("AoS") {
+        checkTouched(MultiStorage<DataLayout::AoS, uninitializedDofs>(plan, &resource));
+    }
+    SUBCASE("AoSoA") {
+        checkTouched(MultiStorage<AoSoA<8>, uninitializedDofs>(plan.size() * 4, &resource));
+    }
+}
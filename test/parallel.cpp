@@ -0,0 +1,149 @@
+#include "doctest.h"
+#include "mneme/parallel.hpp"
+#include "mneme/plan.hpp"
+#include "mneme/storage.hpp"
+#include "mneme/view.hpp"
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace mneme;
+
+namespace {
+struct dofs {
+    using type = double;
+    using initialization = ValueInitialization;
+};
+struct material {
+    using type = float;
+    using initialization = ValueInitialization;
+};
+
+struct Interior : public Layer {};
+struct Copy : public Layer {};
+} // namespace
+
+TEST_CASE("Parallel for each") {
+    auto pool = ThreadPool(4);
+    CHECK(pool.size() == 4);
+
+    SUBCASE("Every index is visited once") {
+        constexpr std::size_t size = 1000;
+        for (auto schedule : {Schedule::Static, Schedule::Stealing}) {
+            std::vector<std::atomic<int>> visits(size);
+            parallelFor(
+                size, [&](std::size_t i) { visits[i].fetch_add(1); }, 16, schedule, pool);
+            for (auto const& visit : visits) {
+                CHECK(visit == 1);
+            }
+        }
+    }
+
+    SUBCASE("Exceptions are rethrown") {
+        auto throwing = [](std::size_t i) {
+            if (i == 42) {
+                throw std::runtime_error("42");
+            }
+        };
+        CHECK_THROWS_AS(parallelFor(100, throwing, 1, Schedule::Static, pool), std::runtime_error);
+        std::atomic<int> count = 0;
+        parallelFor(100, [&](std::size_t) { ++count; }, 1, Schedule::Static, pool);
+        CHECK(count == 100);
+    }
+
+    SUBCASE("Nested loops run serially") {
+        std::atomic<int> count = 0;
+        parallelFor(
+            8,
+            [&](std::size_t) {
+                parallelFor(8, [&](std::size_t) { ++count; }, 1, Schedule::Static, pool);
+            },
+            1, Schedule::Static, pool);
+        CHECK(count == 64);
+    }
+
+    SUBCASE("Views and layers") {
+        using storage_t = MultiStorage<DataLayout::SoA, dofs, material>;
+        using aosoa_t = MultiStorage<AoSoA<8>, dofs>;
+        CHECK(detail::entryGrain(static_cast<storage_t const*>(nullptr)) == 16);
+        CHECK(detail::entryGrain(static_cast<aosoa_t const*>(nullptr)) == 8);
+
+        const auto plan = LayeredPlan()
+                              .withDofs<Interior>(300, [](auto) { return 1U; })
+                              .withDofs<Copy>(50, [](auto) { return 1U; });
+        auto storage = std::make_shared<storage_t>(plan);
+        const auto factory = createViewFactory().withPlan(plan).withStorage(storage);
+
+        auto view =
+            createViewFactory().withPlan(plan).withStorage(storage).createDenseView<Interior>();
+        CHECK(detail::ViewTraits<decltype(view)>::grain(view) == 16);
+        parallelForEach(
+            view, [](auto element) { element.template get<dofs>() = 1.0; }, Schedule::Stealing,
+            pool);
+        parallelForEach<Interior, Copy>(
+            factory, [](auto element) { element.template get<material>() += 2.0f; }, pool);
+
+        for (std::size_t i = 0; i < storage->size(); ++i) {
+            CHECK((*storage)[i].get<dofs>() == (i < 300 ? 1.0 : 0.0));
+            CHECK((*storage)[i].get<material>() == 2.0f);
+        }
+
+        // Copy starts at entry 300, i.e. 12 entries into a group of 16 that fill whole lines.
+        auto copyFactory = factory;
+        auto copyView = copyFactory.createDenseView<Copy>();
+        CHECK(copyView.firstEntry() == 300);
+        CHECK(detail::ViewTraits<decltype(copyView)>::shift(copyView) == 12);
+        std::vector<std::thread::id> owner(copyView.size());
+        parallelForEach(
+            copyView,
+            [&](auto element) {
+                const auto entry = &element.template get<dofs>() - &(*storage)[0].get<dofs>();
+                owner[entry - 300] = std::this_thread::get_id();
+            },
+            Schedule::Static, pool);
+        for (std::size_t i = 1; i < owner.size(); ++i) {
+            if ((300 + i) % 16 != 0) {
+                CHECK(owner[i] == owner[i - 1]);
+            }
+        }
+        CHECK(owner.front() != owner.back());
+    }
+
+    SUBCASE("Dynamic strides") {
+        using storage_t = MultiStorage<DataLayout::SoA, dofs>;
+
+        const auto plan = LayeredPlan()
+                              .withDofs<Interior>(100, [](auto) { return 3U; })
+                              .withDofs<Copy>(20, [](auto) { return 3U; });
+        auto storage = std::make_shared<storage_t>(plan);
+        const auto factory =
+            createViewFactory().withPlan(plan).withStorage(storage).withDynamicStride();
+
+        auto view = factory.createStridedView<Interior>();
+        CHECK(view.stride() == 3);
+        CHECK(detail::ViewTraits<decltype(view)>::grain(view) == 8);
+        parallelForEach(
+            view,
+            [](auto element) {
+                for (auto& dof : element.template get<dofs>()) {
+                    dof += 1.0;
+                }
+            },
+            Schedule::Static, pool);
+        parallelForEach<Interior, Copy>(
+            factory,
+            [](auto element) {
+                for (auto& dof : element.template get<dofs>()) {
+                    dof += 2.0;
+                }
+            },
+            pool);
+
+        for (std::size_t i = 0; i < storage->size(); ++i) {
+            CHECK((*storage)[i].get<dofs>() == (i < 300 ? 3.0 : 2.0));
+        }
+    }
+}
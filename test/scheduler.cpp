@@ -0,0 +1,137 @@
+#include "doctest.h"
+#include "mneme/parallel.hpp"
+#include "mneme/plan.hpp"
+#include "mneme/scheduler.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using namespace mneme;
+
+namespace {
+struct Interior : public Layer {};
+struct Copy : public Layer {};
+struct Ghost : public Layer {};
+
+/**
+ * Records the order of all steps; stands in for an MPI halo exchange.
+ */
+struct RecordingCommunication {
+    std::mutex mutex;
+    std::vector<std::string> events;
+
+    void record(std::string event) {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(std::move(event));
+    }
+    void post(std::size_t clusterId) { record("post" + std::to_string(clusterId)); }
+    void wait(std::size_t clusterId) { record("wait" + std::to_string(clusterId)); }
+
+    std::size_t position(std::string const& event) const {
+        for (std::size_t i = 0; i < events.size(); ++i) {
+            if (events[i] == event) {
+                return i;
+            }
+        }
+        return events.size();
+    }
+};
+} // namespace
+
+TEST_CASE("Task graph scheduler") {
+    auto pool = ThreadPool(3);
+
+    SUBCASE("Dependencies are respected") {
+        TaskGraph graph;
+        std::atomic<int> a = 0, b = 0, c = 0;
+        const auto first = graph.addTask([&] { a = 1; });
+        const auto left = graph.addTask([&] { b = a + 1; }, {first});
+        const auto right = graph.addTask([&] { c = a + 2; }, {first});
+        std::atomic<int> result = 0;
+        graph.addTask([&] { result = b + c; }, {left, right});
+        CHECK(graph.size() == 4);
+        graph.run(pool);
+        CHECK(result == 5);
+        CHECK_THROWS_AS(graph.addTask([] {}, {4}), std::invalid_argument);
+    }
+
+    SUBCASE("Ready tasks of high priority run first") {
+        TaskGraph graph;
+        std::mutex mutex;
+        std::vector<int> order;
+        auto record = [&](int i) {
+            return [&, i] {
+                std::lock_guard<std::mutex> lock(mutex);
+                order.push_back(i);
+            };
+        };
+        const auto first = graph.addTask(record(0));
+        graph.addTask(record(1), {first});
+        graph.addTask(record(2), {first}, TaskGraph::Priority::High);
+        graph.addTask(record(3), {}, TaskGraph::Priority::High);
+        auto serialPool = ThreadPool(1);
+        graph.run(serialPool);
+        CHECK(order == std::vector<int>{3, 0, 2, 1});
+    }
+
+    SUBCASE("Exceptions stop the graph") {
+        TaskGraph graph;
+        std::atomic<bool> reached = false;
+        const auto failing = graph.addTask([] { throw std::runtime_error("task failed"); });
+        graph.addTask([&] { reached = true; }, {failing});
+        CHECK_THROWS_AS(graph.run(pool), std::runtime_error);
+        CHECK(!reached);
+    }
+
+    SUBCASE("Clusters overlap communication with the interior") {
+        const auto plan = LayeredPlan()
+                              .withDofs<Interior>(10, [](auto) { return 1U; })
+                              .withDofs<Copy>(3, [](auto) { return 1U; })
+                              .withDofs<Ghost>(2, [](auto) { return 1U; });
+        const auto combinedPlan = CombinedLayeredPlan(std::vector{plan, plan, plan});
+        RecordingCommunication communication;
+        std::atomic<std::size_t> numElements = 0;
+        auto compute = [&](std::size_t clusterId, auto const& layer) {
+            using layer_t = std::decay_t<decltype(layer)>;
+            numElements += layer.numElements;
+            const auto name = std::is_same_v<layer_t, Copy>       ? "copy"
+                              : std::is_same_v<layer_t, Interior> ? "interior"
+                                                                  : "ghost";
+            communication.record(name + std::to_string(clusterId));
+        };
+        auto graph = makeClusterTaskGraph<Copy, Interior, Ghost>(combinedPlan, compute,
+                                                                 communication);
+        CHECK(graph.size() == 5 * combinedPlan.numberOfClusters());
+        graph.run(pool);
+
+        CHECK(numElements == 3 * plan.size());
+        CHECK(communication.events.size() == graph.size());
+        for (std::size_t clusterId = 0; clusterId < 3; ++clusterId) {
+            const auto id = std::to_string(clusterId);
+            CHECK(communication.position("copy" + id) < communication.position("post" + id));
+            CHECK(communication.position("post" + id) < communication.position("wait" + id));
+            CHECK(communication.position("wait" + id) < communication.position("ghost" + id));
+            CHECK(communication.position("interior" + id) < communication.position("wait" + id));
+            for (std::size_t other = 0; other < 3; ++other) {
+                CHECK(communication.position("copy" + id) <
+                      communication.position("interior" + std::to_string(other)));
+            }
+        }
+
+        auto serialPool = ThreadPool(1);
+        communication.events.clear();
+        graph.run(serialPool);
+        CHECK(communication.events[0] == "copy0");
+        CHECK(communication.events[1] == "post0");
+        CHECK(communication.position("post2") < communication.position("interior0"));
+
+        auto noCommunication = NoCommunication();
+        makeClusterTaskGraph<Copy, Interior, Ghost>(combinedPlan, compute, noCommunication)
+            .run(serialPool);
+        CHECK(communication.events.size() == 2 * graph.size() - 2 * 3);
+    }
+}
@@ -0,0 +1,146 @@
+#include "doctest.h"
+#include "mneme/plan.hpp"
+#include "mneme/serialization.hpp"
+#include "mneme/storage.hpp"
+
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+
+using namespace mneme;
+
+namespace {
+struct dofs {
+    using type = double;
+    using initialization = ValueInitialization;
+};
+struct material {
+    using type = int;
+    using initialization = ValueInitialization;
+};
+
+struct Interior : public Layer {};
+struct Copy : public Layer {};
+struct Ghost : public Layer {};
+
+template <typename Storage> void fill(Storage& storage) {
+    for (std::size_t i = 0; i < storage.size(); ++i) {
+        storage[i].template get<dofs>() = 0.5 * static_cast<double>(i);
+        storage[i].template get<material>() = 7;
+    }
+}
+} // namespace
+
+TEST_CASE("Layer-selective serialization") {
+    const auto plan = LayeredPlan()
+                          .withDofs<Interior>(300, [](auto i) { return 1U + i % 4U; })
+                          .withDofs<Copy>(50, [](auto) { return 3U; })
+                          .withDofs<Ghost>(50, [](auto) { return 3U; });
+    const auto& layout = plan.getLayout();
+    const auto ghost = plan.getLayer<Ghost>();
+    const auto ghostFrom = layout[ghost.offset];
+
+    SUBCASE("SoA round trip skips Ghost") {
+        using storage_t = MultiStorage<DataLayout::SoA, dofs, material>;
+        auto storage = storage_t(plan);
+        fill(storage);
+        std::stringstream stream;
+        writeStorage(stream, plan, storage, LayerSelection<Interior, Copy>{},
+                     IdSelection<dofs, material>{});
+
+        auto restored = storage_t(plan);
+        readStorage(stream, plan, restored, LayerSelection<Interior, Copy>{},
+                    IdSelection<dofs, material>{});
+        for (std::size_t i = 0; i < ghostFrom; ++i) {
+            REQUIRE(restored[i].get<dofs>() == storage[i].get<dofs>());
+            REQUIRE(restored[i].get<material>() == 7);
+        }
+        for (std::size_t i = ghostFrom; i < restored.size(); ++i) {
+            REQUIRE(restored[i].get<dofs>() == 0.0);
+            REQUIRE(restored[i].get<material>() == 0);
+        }
+    }
+
+    SUBCASE("Compressed round trip between layouts") {
+        auto storage = MultiStorage<DataLayout::AoS, dofs, material>(plan);
+        fill(storage);
+        std::stringstream raw;
+        std::stringstream compressed;
+        writeStorage(raw, plan, storage, LayerSelection<Interior>{}, IdSelection<material>{});
+        writeStorage(compressed, plan, storage, LayerSelection<Interior>{},
+                     IdSelection<material>{}, ShuffleRleCompression{});
+        CHECK(compressed.str().size() < raw.str().size());
+
+        auto restored = MultiStorage<AoSoA<4>, dofs, material>(plan);
+        readStorage(compressed, plan, restored, LayerSelection<Interior>{},
+                    IdSelection<material>{}, ShuffleRleCompression{});
+        const auto copyFrom = layout[plan.getLayer<Copy>().offset];
+        for (std::size_t i = 0; i < restored.size(); ++i) {
+            REQUIRE(restored[i].get<material>() == (i < copyFrom ? 7 : 0));
+            REQUIRE(restored[i].get<dofs>() == 0.0);
+        }
+
+        std::stringstream mixed;
+        writeStorage(mixed, plan, storage, LayerSelection<Interior, Copy, Ghost>{},
+                     IdSelection<dofs>{}, ShuffleRleCompression{});
+        auto soa = MultiStorage<DataLayout::SoA, dofs, material>(plan);
+        readStorage(mixed, plan, soa, LayerSelection<Interior, Copy, Ghost>{},
+                    IdSelection<dofs>{}, ShuffleRleCompression{});
+        for (std::size_t i = 0; i < soa.size(); ++i) {
+            REQUIRE(soa[i].get<dofs>() == storage[i].get<dofs>());
+        }
+    }
+
+    SUBCASE("Dofs per element are compressed") {
+        constexpr std::size_t numElements = 100000;
+        const auto largePlan =
+            LayeredPlan().withDofs<Interior>(numElements, [](auto i) { return 1U + i % 4U; });
+        auto storage = MultiStorage<DataLayout::SoA, dofs, material>(largePlan);
+        fill(storage);
+        std::stringstream stream;
+        writeStorage(stream, largePlan, storage, LayerSelection<Interior>{},
+                     IdSelection<material>{}, ShuffleRleCompression{});
+        CHECK(stream.str().size() < numElements * sizeof(std::uint64_t) / 4);
+
+        auto restored = MultiStorage<DataLayout::SoA, dofs, material>(largePlan);
+        readStorage(stream, largePlan, restored, LayerSelection<Interior>{},
+                    IdSelection<material>{}, ShuffleRleCompression{});
+        CHECK(restored[restored.size() - 1].get<material>() == 7);
+    }
+
+    SUBCASE("Mismatches are rejected") {
+        using storage_t = MultiStorage<DataLayout::SoA, dofs, material>;
+        auto storage = storage_t(plan);
+        std::stringstream stream;
+        writeStorage(stream, plan, storage, LayerSelection<Interior, Copy>{}, IdSelection<dofs>{});
+        const auto data = stream.str();
+
+        std::stringstream wrongIds(data);
+        CHECK_THROWS_AS(readStorage(wrongIds, plan, storage, LayerSelection<Interior, Copy>{},
+                                    IdSelection<material>{}),
+                        std::runtime_error);
+        std::stringstream wrongLayers(data);
+        CHECK_THROWS_AS(readStorage(wrongLayers, plan, storage, LayerSelection<Interior>{},
+                                    IdSelection<dofs>{}),
+                        std::runtime_error);
+        std::stringstream wrongCompressor(data);
+        CHECK_THROWS_AS(readStorage(wrongCompressor, plan, storage,
+                                    LayerSelection<Interior, Copy>{}, IdSelection<dofs>{},
+                                    ShuffleRleCompression{}),
+                        std::runtime_error);
+        // Same layers and total number of dofs, but shifted dofs per element.
+        const auto shiftedDofs = [](auto i) { return 1U + (i + 1) % 4U; };
+        const auto shiftedPlan = LayeredPlan()
+                                     .withDofs<Interior>(300, shiftedDofs)
+                                     .withDofs<Copy>(50, [](auto) { return 3U; })
+                                     .withDofs<Ghost>(50, [](auto) { return 3U; });
+        std::stringstream wrongDofs(data);
+        CHECK_THROWS_AS(readStorage(wrongDofs, shiftedPlan, storage,
+                                    LayerSelection<Interior, Copy>{}, IdSelection<dofs>{}),
+                        std::runtime_error);
+        std::stringstream truncated(data.substr(0, data.size() - 8));
+        CHECK_THROWS_AS(readStorage(truncated, plan, storage, LayerSelection<Interior, Copy>{},
+                                    IdSelection<dofs>{}),
+                        std::runtime_error);
+    }
+}
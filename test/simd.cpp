@@ -0,0 +1,73 @@
+#include "doctest.h"
+#include "mneme/plan.hpp"
+#include "mneme/simd.hpp"
+#include "mneme/storage.hpp"
+#include "mneme/view.hpp"
+
+#include <memory>
+
+using namespace mneme;
+
+namespace {
+struct density {
+    using type = double;
+};
+struct velocity {
+    using type = double;
+};
+struct energy {
+    using type = double;
+    using initialization = ValueInitialization;
+};
+
+struct Interior : public Layer {};
+struct Ghost : public Layer {};
+
+template <typename Storage> void checkBatches() {
+    constexpr std::size_t W = 4;
+    const auto plan = LayeredPlan()
+                          .template withDofs<Ghost>(3, [](auto) { return 1U; })
+                          .template withDofs<Interior>(11, [](auto) { return 1U; });
+    auto storage = std::make_shared<Storage>(plan);
+    for (std::size_t i = 0; i < storage->size(); ++i) {
+        (*storage)[i].template get<density>() = static_cast<double>(i);
+        (*storage)[i].template get<velocity>() = 2.0;
+    }
+    auto view = createViewFactory()
+                    .withPlan(plan)
+                    .withStorage(storage)
+                    .template createDenseView<Interior>();
+    CHECK(numBatches<W>(view) == 3);
+
+    std::size_t numFull = 0;
+    forEachBatch<W>(view, [&](auto const& batch) {
+        numFull += batch.isFull();
+        const auto rho = batch.template load<density>();
+        for (std::size_t k = batch.size(); k < W; ++k) {
+            CHECK(rho[k] == 0.0);
+        }
+        batch.template store<energy>(0.5 * rho * batch.template load<velocity>() + 1.0);
+    });
+    CHECK(numFull == 2);
+
+    for (std::size_t i = 0; i < storage->size(); ++i) {
+        const auto expected = i < 3 ? 0.0 : static_cast<double>(i) + 1.0;
+        CHECK((*storage)[i].template get<energy>() == expected);
+    }
+}
+} // namespace
+
+TEST_CASE("SIMD batches") {
+    auto p = pack<double, 4>::broadcast(2.0);
+    p[1] = 4.0;
+    const auto q = -(p * p - 1.0) / 2.0;
+    CHECK(q[0] == -1.5);
+    CHECK(q[1] == -7.5);
+
+    SUBCASE("SoA") { checkBatches<MultiStorage<DataLayout::SoA, density, velocity, energy>>(); }
+    SUBCASE("SoA arena") {
+        checkBatches<MultiStorage<DataLayout::SoAArena, density, velocity, energy>>();
+    }
+    SUBCASE("AoSoA") { checkBatches<MultiStorage<AoSoA<4>, density, velocity, energy>>(); }
+    SUBCASE("AoS") { checkBatches<MultiStorage<DataLayout::AoS, density, velocity, energy>>(); }
+}